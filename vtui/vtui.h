@@ -123,14 +123,14 @@ typedef void *(vtui_realloc)(void *, VTUI_SIZE);                    //realloc
 //  special care should be taken when implementing vtui_write to ensure that it
 //  writes bytes as atomically as possible, otherwise the terminal may flicker
 //  agressively,  due to the inconsistent state non-atomic writes will leave it
-//  in. expects that the number of bytes written will equal the number of bytes
-//  provided, otherwise vtui will treat it as an error (incomplete write)
+//  in. a blocking vtui_write should write every byte provided; a non-blocking
+//  one may write fewer (even zero), in which case the rest are kept pending
+//  until vtui_flush is called. a negative return is treated as an error
 typedef int (vtui_write)(void *file, const char *buf, VTUI_SIZE bytes);
 
 // string formatting function typedefs
 
 // a restricted version of snprintf, the only format specifiers used are
-// * %u (unsigned decimal integer) 
 // * %s.* (string, variable maximum number of characters)
 // * %lc (long character / wint or smthn, used to print a unicode codepoint)
 // returns bytes written, or a negative number if an error occurs; string is 
@@ -138,8 +138,71 @@ typedef int (vtui_write)(void *file, const char *buf, VTUI_SIZE bytes);
 // greater than zero, but less than bytes
 typedef int (vtui_snprintf)(char *buf, size_t bytes, const char *format, ...);
 
+// ## VTUI HOOK DISPATCH ##
+
+// by default vtui calls malloc, free, memcpy, realloc, write, and snprintf
+// through the function pointers stored in each vtui (and vtui_grid). defining
+// VTUI_STATIC_HOOKS binds them at compile time instead, which lets the
+// compiler inline them into the update routines; the function pointers are
+// then left out of the structures entirely. VTUI_MALLOC, VTUI_FREE,
+// VTUI_MEMCPY, VTUI_REALLOC, and VTUI_SNPRINTF default to their C library
+// counterparts, while VTUI_WRITE has no default and must be provided.
+
+#ifdef VTUI_STATIC_HOOKS
+
+#ifndef VTUI_MALLOC
+#include <stdlib.h>
+#define VTUI_MALLOC malloc
+#endif
+
+#ifndef VTUI_FREE
+#include <stdlib.h>
+#define VTUI_FREE free
+#endif
+
+#ifndef VTUI_MEMCPY
+#include <string.h>
+#define VTUI_MEMCPY memcpy
+#endif
+
+#ifndef VTUI_REALLOC
+#include <stdlib.h>
+#define VTUI_REALLOC realloc
+#endif
+
+#ifndef VTUI_SNPRINTF
+#include <stdio.h>
+#define VTUI_SNPRINTF snprintf
+#endif
+
+#ifndef VTUI_WRITE
+#error "VTUI_STATIC_HOOKS requires VTUI_WRITE to be defined"
+#endif
+
+#define _vtui_malloc(owner) VTUI_MALLOC
+#define _vtui_free(owner) VTUI_FREE
+#define _vtui_memcpy(owner) VTUI_MEMCPY
+#define _vtui_realloc(owner) VTUI_REALLOC
+#define _vtui_write(owner) VTUI_WRITE
+#define _vtui_snprintf(owner) VTUI_SNPRINTF
+
+#else
+// dynamic dispatch through the owner's function pointers
+
+#define _vtui_malloc(owner) ((owner)->malloc)
+#define _vtui_free(owner) ((owner)->free)
+#define _vtui_memcpy(owner) ((owner)->memcpy)
+#define _vtui_realloc(owner) ((owner)->realloc)
+#define _vtui_write(owner) ((owner)->write)
+#define _vtui_snprintf(owner) ((owner)->snprintf)
+
+#endif
+
 // ## quick vtui helper functions ##
 
+// length of a string literal (or char array), known at compile time
+#define _vtui_lit_bytes(lit) (sizeof(lit) - 1)
+
 size_t _vtui_strnt_bytes(const char *str) {
     size_t i = 0;
     while (str[i] != VTUI_NUL[0]) {
@@ -166,6 +229,80 @@ typedef struct vtui_cursor_state {
         VTUI_BOOL invisible;
 } vtui_cursor_state;
 
+// glyph ids pack up to four bytes of a utf8 grapheme into a single integer,
+// so the planes never have to borrow the grid's grapheme pointers; longer
+// graphemes cannot be packed and are always redrawn
+#define _VTUI_GLYPH_INVALID 0           // front cell must be redrawn
+#define _VTUI_GLYPH_UNCACHED 0xFFFFFFFF // grapheme too long to pack
+
+// palette indices run from 0 to _VTUI_PALETTE_MAX - 1, the max doubles as a
+// color that could not be interned, cells with it are always redrawn
+#define _VTUI_PALETTE_MAX 0xFFFF
+
+// once this many colors are interned, and at least a quarter of them since the
+// last reset, the palette is rebuilt from only the colors the grid's cells
+// still reference. front planes are carried over through a map from old
+// indices to new ones, so only cells whose colors are gone are redrawn; a vtui
+// which missed a reset entirely (by not being updated in between two of them)
+// is redrawn whole. each reset reinterns every row of the grid. once a grid
+// references most of the palette on its own, colors past the end of it are
+// not interned at all, and the cells using them are redrawn on every update
+
+#ifndef VTUI_PALETTE_RESET
+
+#define VTUI_PALETTE_RESET 0xF000
+
+#endif
+
+// private palette -- interns the colors of a grid's cells
+typedef struct _vtui_palette {
+    vtui_color *colors;
+    VTUI_SIZE count;
+    VTUI_SIZE capacity;
+    // open addressed hash table of color index + 1, 0 marks an empty slot
+    VTUI_UINT16 *slots;
+    VTUI_SIZE slot_count; // always a power of two
+} _vtui_palette;
+
+// a vtui_grid is a row-major plane of cells, indexed from 0 (unlike cursor
+// positions). a single grid can be shared as the back grid of many vtuis, so a
+// screen is composed once and only diffed / encoded once per output.
+typedef struct vtui_grid {
+    // fn pntrs, used to manage the grid's memory
+#ifndef VTUI_STATIC_HOOKS
+    vtui_malloc *malloc;
+    vtui_free *free;
+#endif
+
+    // variables
+
+    VTUI_AXIS rows;
+    VTUI_AXIS cols;
+    vtui_cell *cells;
+
+    // generation stamps, bumped whenever a row is written -- lets every vtui
+    // drawing this grid skip the rows it has already sent to its output
+    VTUI_SIZE generation;
+    VTUI_SIZE *row_generation;
+    VTUI_SIZE resize_generation; // generation as of the last resize
+
+    // private variables
+
+    // cells interned into dense planes of glyph ids and palette indices, which
+    // is what every vtui drawing the grid diffs against; a row is interned
+    // once per write, at the first update to draw it
+    VTUI_UINT32 *_glyphs;
+    VTUI_UINT16 *_fgs;
+    VTUI_UINT16 *_bgs;
+    VTUI_SIZE *_interned_generation; // row_generation as of interning
+    _vtui_palette _palette;
+    VTUI_SIZE _palette_generation; // bumped whenever the palette is reset
+    VTUI_SIZE _palette_live; // colors referenced as of the last reset
+    // old index to new index, as of the last reset; may be NULL
+    VTUI_UINT16 *_palette_remap;
+    VTUI_SIZE _palette_remap_count;
+} vtui_grid;
+
 // private update buffer state enum -- used to fuse commands where possible
 typedef enum _vtui_update_buffer_state {
     _vtui_update_buffer_state_last_cmd_was_not_sgr = 0,
@@ -177,27 +314,43 @@ typedef struct _vtui_update_buffer {
     char *text;
     size_t cur_bytes;
     size_t capacity;
+    size_t sent; // bytes already written out, when a write was partial
     _vtui_update_buffer_state state;
 } _vtui_update_buffer;
 
+// private front planes -- what was last drawn to each cell of the output,
+// laid out like the back grid's planes so that the two are compared plane by
+// plane; 8 bytes per cell in total
+typedef struct _vtui_front_planes {
+    VTUI_UINT32 *glyphs;
+    VTUI_UINT16 *fgs;
+    VTUI_UINT16 *bgs;
+    VTUI_SIZE capacity; // cells allocated in each plane
+} _vtui_front_planes;
+
 // primary vtui structure -- represents a single vtui on a single output
 typedef struct vtui {
     // first up, fn pntrs
-
+#ifndef VTUI_STATIC_HOOKS
     vtui_malloc *malloc;
     vtui_free *free;
     vtui_memcpy *memcpy;
     vtui_realloc *realloc;
     vtui_write *write;
     vtui_snprintf *snprintf;
+#endif
 
     // variables
 
     void *out_file; //may not actually be a voidp: using it as a catch-all type
-    
+
     // TODO rendering variables
     // boxes, front boxes
 
+    // the grid to be drawn -- not owned, and may be shared with other vtuis
+    vtui_grid *back;
+    VTUI_SIZE back_generation; // back->generation as of the last update
+
     vtui_cursor_state cursor;
     VTUI_BOOL beep;
 
@@ -207,24 +360,44 @@ typedef struct vtui {
     vtui_color front_bg;
     VTUI_BOOL front_colors_initalized;
 
+    // front grid, owned by this vtui; colors are indices into the back grid's
+    // palette. when not valid, the next update is forced to be a full redraw
+    _vtui_front_planes front_planes;
+    VTUI_SIZE back_palette_generation; // palette the front indices refer to
+    VTUI_AXIS front_rows;
+    VTUI_AXIS front_cols;
+    VTUI_BOOL front_valid;
+
+    // pending output size, applied at the next update so that a burst of
+    // resizes only reallocates and redraws once; the smallest size seen in the
+    // burst bounds what survives it
+    VTUI_AXIS _resize_rows;
+    VTUI_AXIS _resize_cols;
+    VTUI_AXIS _resize_min_rows;
+    VTUI_AXIS _resize_min_cols;
+    VTUI_BOOL _resize_pending;
+
     // internal update buffer -- used to build updates as one long string
     _vtui_update_buffer _buffer;
 } vtui;
 
 // ## VTUI UPDATE BUFFER ROUTINES ##
 
-// push bytes into a vtui's update buffer
-//  internally handles memory reallocation, and can fail with VTUI_ENOMEM; also
-//  supports overwriting some of the bytes already in the buffer, but does not
-//  sanity check overwrite to prevent underflows, or that bytes is greater than
-//  overwrite (unsigned math goes out the window when you subtract from 0)
-int _vtui_pushBytes(vtui *vtui, const char *buf, VTUI_SIZE bytes, VTUI_SIZE over) {
-    if (vtui->_buffer.cur_bytes + bytes - over > vtui->_buffer.capacity) {
+// initial capacity of an update buffer that has not been allocated yet
+#define _VTUI_BUFFER_MIN_CAPACITY 256
+
+// make sure a vtui's update buffer has room for bytes more bytes
+//  internally handles memory reallocation, and can fail with VTUI_ENOMEM
+int _vtui_reserveBytes(vtui *vtui, VTUI_SIZE bytes) {
+    if (vtui->_buffer.cur_bytes + bytes > vtui->_buffer.capacity) {
         size_t newcapacity = vtui->_buffer.capacity;
-        while (vtui->_buffer.cur_bytes + bytes - over > newcapacity) {
+        if (newcapacity == 0) {
+            newcapacity = _VTUI_BUFFER_MIN_CAPACITY;
+        }
+        while (vtui->_buffer.cur_bytes + bytes > newcapacity) {
             newcapacity <<= 1;
         }
-        void *pntr = vtui->realloc(vtui->_buffer.text, newcapacity);
+        void *pntr = _vtui_realloc(vtui)(vtui->_buffer.text, newcapacity);
         if (pntr != VTUI_NULL) {
             vtui->_buffer.text = (char *) pntr;
             vtui->_buffer.capacity = newcapacity;
@@ -233,9 +406,22 @@ int _vtui_pushBytes(vtui *vtui, const char *buf, VTUI_SIZE bytes, VTUI_SIZE over
             return VTUI_ENOMEM;
         }
     }
+    return VTUI_OK;
+}
+
+// push bytes into a vtui's update buffer
+//  internally handles memory reallocation, and can fail with VTUI_ENOMEM; also
+//  supports overwriting some of the bytes already in the buffer, but does not
+//  sanity check overwrite to prevent underflows, or that bytes is greater than
+//  overwrite (unsigned math goes out the window when you subtract from 0)
+int _vtui_pushBytes(vtui *vtui, const char *buf, VTUI_SIZE bytes, VTUI_SIZE over) {
+    int err = _vtui_reserveBytes(vtui, bytes - over);
+    if (err != VTUI_OK) {
+        return err;
+    }
     // memcpy bytes into the buffer
     size_t offset = vtui->_buffer.cur_bytes - over;
-    vtui->memcpy(&vtui->_buffer.text[offset], buf, bytes);
+    _vtui_memcpy(vtui)(&vtui->_buffer.text[offset], buf, bytes);
     vtui->_buffer.cur_bytes += bytes - over;
     // success!
     return VTUI_OK;
@@ -244,18 +430,27 @@ int _vtui_pushBytes(vtui *vtui, const char *buf, VTUI_SIZE bytes, VTUI_SIZE over
 // flush a vtui's update buffer to the screen
 //  can fail with VTUI_EIO (generic I/O error); if an error occurs while
 //  writing, a partial write may have occurred, leaving the vtui in an
-//  inconsisent state!
+//  inconsisent state! returns VTUI_EAGAIN if only some of the buffer could be
+//  written, the rest is kept to be written by the next flush
 int _vtui_flush(vtui *vtui) {
-    if (vtui->_buffer.cur_bytes > 0){
+    if (vtui->_buffer.cur_bytes > vtui->_buffer.sent){
         _vtui_update_buffer *buffer = &vtui->_buffer;
-        int written = vtui->write(
-            vtui->out_file, buffer->text, buffer->cur_bytes);
-        if (written == buffer->cur_bytes) {
+        int written = _vtui_write(vtui)(vtui->out_file,
+            &buffer->text[buffer->sent], buffer->cur_bytes - buffer->sent);
+        if (written < 0) {
+            // some error or another!
+            return VTUI_EIO;
+        }
+        buffer->sent += written;
+        // sent bytes can't be fused into
+        buffer->state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+        if (buffer->sent == buffer->cur_bytes) {
             buffer->cur_bytes = 0;
+            buffer->sent = 0;
             return VTUI_OK;
         } else {
-            // incomplete write, or some other error!
-            return VTUI_EIO;
+            // incomplete write, the rest is still pending
+            return VTUI_EAGAIN;
         }
     } else {
         // no bytes to write, silent success
@@ -276,21 +471,20 @@ int _vtui_pushCmd(vtui *vtui, const char *cmd, int bytes) {
 
 // push a sgr command
 int _vtui_pushSgrCmd(vtui *vtui, const char *cmd, int bytes) {
-    int overwrite;
     char *base;
     size_t len;
     if (vtui->_buffer.state == _vtui_update_buffer_state_last_cmd_was_sgr) {
-        overwrite = _vtui_strnt_bytes("m"); // splat over the m of the prev cmd
-        len  = bytes - _vtui_strnt_bytes(VTUI_CSI); // skip the csi
-        char *base = ((char *) cmd) + _vtui_strnt_bytes(VTUI_CSI); // ditto
+        // turn the m of the prev cmd into a parameter separator
+        vtui->_buffer.text[vtui->_buffer.cur_bytes - 1] = ';';
+        len  = bytes - _vtui_lit_bytes(VTUI_CSI); // skip the csi
+        base = ((char *) cmd) + _vtui_lit_bytes(VTUI_CSI); // ditto
     } else {
-        overwrite = 0;
         base = ((char *) cmd);
         len = bytes;
     }
-    int err = _vtui_pushBytes(vtui, base, len, overwrite);
+    int err = _vtui_pushBytes(vtui, base, len, 0);
     if (err == VTUI_OK) {
-        vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+        vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_sgr;
         return VTUI_OK;
     } else {
         return err;
@@ -301,45 +495,45 @@ int _vtui_pushSgrCmd(vtui *vtui, const char *cmd, int bytes) {
 
 // reset the terminal's Select Graphics Rendition state
 int _vtui_vt_resetSgr(vtui *vtui) {
-    const char *cmd = VTUI_CSI "0m";
+    static const char cmd[] = VTUI_CSI "0m";
     // VTUI doesn't know how to handle non-truecolor colors
     vtui->front_colors_initalized = VTUI_FALSE;
-    return _vtui_pushSgrCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushSgrCmd(vtui, cmd, _vtui_lit_bytes(cmd));
     
 }
 
 // unhide the cursor, making it visible
 int _vtui_vt_showCursor(vtui *vtui) {
-    const char *cmd = VTUI_CSI "?25h";
+    static const char cmd[] = VTUI_CSI "?25h";
     vtui->front_cursor.invisible = VTUI_FALSE;
-    return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
 }
 
 // hide the cursor, making it invisible
 int _vtui_vt_hideCursor(vtui *vtui) {
-    const char *cmd = VTUI_CSI "?25l";
+    static const char cmd[] = VTUI_CSI "?25l";
     vtui->front_cursor.invisible = VTUI_TRUE;
-    return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
 }
 
 // make a beep on the terminal
 int _vtui_vt_beep(vtui *vtui) {
-    const char *cmd = VTUI_BEL;
+    static const char cmd[] = VTUI_BEL;
     vtui->beep = VTUI_FALSE; //do not beep again
-    return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
 }
 
 // clears the screen and sometimes resets cursor position to the top left,
 // colors need to be initalized before calling, otherwise will fail with
 // VTUI_EWRONGSTATE.
 int _vtui_vt_clearScreen(vtui *vtui) {
-    const char *cmd = VTUI_CSI "2J";
+    static const char cmd[] = VTUI_CSI "2J";
     if (vtui->front_colors_initalized) {
         // no idea where this puts the cursor -- send it off to hyperspace
         vtui->front_cursor.row = VTUI_HYPERSPACE;
         vtui->front_cursor.col = VTUI_HYPERSPACE;
         //TODO clear the front surface!
-        return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+        return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
     } else {
         return VTUI_EWRONGSTATE;
     }
@@ -347,22 +541,22 @@ int _vtui_vt_clearScreen(vtui *vtui) {
 
 // enter the alternate screen buffer
 int _vtui_vt_enterAlt(vtui *vtui) {
-    const char *cmd = VTUI_CSI "1049h";
+    static const char cmd[] = VTUI_CSI "1049h";
     // no idea where this puts the cursor -- send it off to hyperspace
     vtui->front_cursor.row = VTUI_HYPERSPACE;
     vtui->front_cursor.col = VTUI_HYPERSPACE;
-    return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
     //TODO if the alternate screen buffer is not supported, clear sufficient
     // space to avoid overwriting scrollback buffer text
 }
 
 // exit the alternate screen buffer
 int _vtui_vt_exitAlt(vtui *vtui) {
-    const char *cmd = VTUI_CSI "1049l";
+    static const char cmd[] = VTUI_CSI "1049l";
     // no idea where this puts the cursor -- send it off to hyperspace
     vtui->front_cursor.row = VTUI_HYPERSPACE;
     vtui->front_cursor.col = VTUI_HYPERSPACE;
-    return _vtui_pushCmd(vtui, cmd, _vtui_strnt_bytes(cmd));
+    return _vtui_pushCmd(vtui, cmd, _vtui_lit_bytes(cmd));
 }
 
 // cursor-movement terminology:
@@ -370,16 +564,68 @@ int _vtui_vt_exitAlt(vtui *vtui) {
 // * home (2)   / home can also mean row/col 0/0 -- the cursor's home position 
 // * hyperspace / where the cursor lives when vtui doesn't know where it is
 
+// room for the longest parameterized command -- a CSI, two 10 digit
+// parameters, and their separator and final byte
+#define _VTUI_CSI_BYTES 32
+
+// copy a short command literal into buf, returning the bytes copied; done by
+// hand so that no hook is called for a couple of bytes
+VTUI_SIZE _vtui_writeLit(char *buf, const char *lit, VTUI_SIZE bytes) {
+    VTUI_SIZE i;
+    for (i = 0; i < bytes; i++) {
+        buf[i] = lit[i];
+    }
+    return bytes;
+}
+
+// write an unsigned integer to buf in decimal, returning the bytes written;
+// buf needs room for up to 10 digits
+VTUI_SIZE _vtui_writeUint(char *buf, unsigned int n) {
+    char digits[10];
+    VTUI_SIZE count = 0;
+    VTUI_SIZE i;
+    do {
+        digits[count++] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    for (i = 0; i < count; i++) {
+        buf[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+// write CSI n <final> to buf, returning the bytes written
+VTUI_SIZE _vtui_writeCsi(char *buf, char final, unsigned int n) {
+    static const char csi[] = VTUI_CSI;
+    VTUI_SIZE bytes = _vtui_writeLit(buf, csi, _vtui_lit_bytes(csi));
+    bytes += _vtui_writeUint(&buf[bytes], n);
+    buf[bytes++] = final;
+    return bytes;
+}
+
+// write CSI row;col H to buf, returning the bytes written
+VTUI_SIZE _vtui_writeCsiRowCol(char *buf, unsigned int row, unsigned int col) {
+    static const char csi[] = VTUI_CSI;
+    VTUI_SIZE bytes = _vtui_writeLit(buf, csi, _vtui_lit_bytes(csi));
+    bytes += _vtui_writeUint(&buf[bytes], row);
+    buf[bytes++] = ';';
+    bytes += _vtui_writeUint(&buf[bytes], col);
+    buf[bytes++] = 'H';
+    return bytes;
+}
+
 // note that moveTo utilizes nondestructive NLs / CRs and a mess of CSI codes
 
 // move the cursor from its current position to the specified position, by any
 // means necessary and using the minimum amount of bytes
 int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
     // if the cursor is not already in position
-    if (vtui->front_cursor.row != row && vtui->front_cursor.col != col) {
+    if (vtui->front_cursor.row != row || vtui->front_cursor.col != col) {
         // check for hyperspace
-        VTUI_BOOL srcrow_hyperspace = row == VTUI_HYPERSPACE;
-        VTUI_BOOL srccol_hyperspace = col == VTUI_HYPERSPACE;
+        VTUI_BOOL srcrow_hyperspace =
+            vtui->front_cursor.row == VTUI_HYPERSPACE;
+        VTUI_BOOL srccol_hyperspace =
+            vtui->front_cursor.col == VTUI_HYPERSPACE;
         VTUI_BOOL any_hyperspace = srcrow_hyperspace | srccol_hyperspace;
 
         // check if destination is a home
@@ -388,9 +634,9 @@ int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
         VTUI_BOOL screen_home = dstrow_home & dstcol_home; 
 
         // compute signed distance
-        VTUI_LI_AXIS row_dist = (VTUI_LI_AXIS) row \
+        VTUI_LI_AXIS row_dist = (VTUI_LI_AXIS) row
             - (VTUI_LI_AXIS) vtui->front_cursor.row;
-        VTUI_LI_AXIS col_dist = (VTUI_LI_AXIS) col \
+        VTUI_LI_AXIS col_dist = (VTUI_LI_AXIS) col
             - (VTUI_LI_AXIS) vtui->front_cursor.col;
 
         // compute signed distance from home
@@ -398,17 +644,8 @@ int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
         VTUI_LI_AXIS hcol_dist = (VTUI_LI_AXIS) col - VTUI_HOME;
 
         // commands
-        const char *relup_fmt = VTUI_CSI "%uA";
-        const char *reldown_fmt = VTUI_CSI "%uB";
-        const char *relfore_fmt = VTUI_CSI "%uC";
-        const char *relback_fmt = VTUI_CSI "%uD";
-        const char *nextline_fmt = VTUI_CSI "%uE";
-        const char *prevline_fmt = VTUI_CSI "%uF";
-        const char *abscol_fmt = VTUI_CSI "%uG";
-        const char *absrc_fmt = VTUI_CSI "%u;%uH";
-
-        int bytes;
-        char cmd_buf[32]; // oversized, to be safe
+        VTUI_SIZE bytes;
+        char cmd_buf[_VTUI_CSI_BYTES];
 
         // hopefully the cursor isn't in hyperspace
         if (!any_hyperspace) {
@@ -418,27 +655,27 @@ int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
                     // if relative movement is closer
                     if (col_dist >= 0) {
                         // positive column movement
-                        bytes = vtui->snprintf(cmd_buf, 32,
-                            relfore_fmt, col_dist);
+                        bytes = _vtui_writeCsi(cmd_buf, 'C',
+                            (unsigned int) col_dist);
                     } else {
                         // negative column movement
-                        bytes = vtui->snprintf(cmd_buf, 32,
-                            relback_fmt, -col_dist);
+                        bytes = _vtui_writeCsi(cmd_buf, 'D',
+                            (unsigned int) -col_dist);
                     }
                 } else {
                     // if absolute movement is closer
-                    bytes = vtui->snprintf(cmd_buf, 32, abscol_fmt, col);
+                    bytes = _vtui_writeCsi(cmd_buf, 'G', (unsigned int) col);
                 }
             } else if (col_dist == 0 && vtui_abs(row_dist) < hrow_dist) {
                 // do relative same-col movement if possible
                 if (row_dist >= 0) {
                     // positive row movement
-                    bytes = vtui->snprintf(cmd_buf, 32,
-                        reldown_fmt, row_dist);
+                    bytes = _vtui_writeCsi(cmd_buf, 'B',
+                        (unsigned int) row_dist);
                 } else {
                     // negative column movement
-                    bytes = vtui->snprintf(cmd_buf, 32,
-                        relup_fmt, -row_dist);
+                    bytes = _vtui_writeCsi(cmd_buf, 'A',
+                        (unsigned int) -row_dist);
                 }
             } else {
                 // cursor has moved in two axes, handle it
@@ -450,37 +687,33 @@ int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
                     // shift to the start of a relative line
                     if (row_dist >= 0) {
                         // positive row movement
-                        bytes = vtui->snprintf(cmd_buf, 32,
-                            nextline_fmt, row_dist);
+                        bytes = _vtui_writeCsi(cmd_buf, 'E',
+                            (unsigned int) row_dist);
                     } else {
                         // negative column movement
-                        bytes = vtui->snprintf(cmd_buf, 32,
-                            prevline_fmt, -row_dist);
+                        bytes = _vtui_writeCsi(cmd_buf, 'F',
+                            (unsigned int) -row_dist);
                     }
                 } else {
                     // full absolute movement is closer
-                    bytes = vtui->snprintf(cmd_buf, 32, absrc_fmt, row, col);
+                    bytes = _vtui_writeCsiRowCol(cmd_buf,
+                        (unsigned int) row, (unsigned int) col);
                 }
             }
         } else {
             // hyperspace encountered, leave using absolute movement
             if (row_dist == 0 && !srcrow_hyperspace) {
                 // if possible, use column absolute movement
-                bytes = vtui->snprintf(cmd_buf, 32, abscol_fmt, col);
+                bytes = _vtui_writeCsi(cmd_buf, 'G', (unsigned int) col);
             } else {
                 // fall back to full absolute movement
-                bytes = vtui->snprintf(cmd_buf, 32, absrc_fmt, row, col);
+                bytes = _vtui_writeCsiRowCol(cmd_buf,
+                        (unsigned int) row, (unsigned int) col);
             }
         }
-        if (bytes > 0 && bytes < 32) {
-            // string successfully written
-            vtui->front_cursor.row = row;
-            vtui->front_cursor.col = col;
-            return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
-        } else {
-            // failed to write formatted string
-            return VTUI_EFMT;
-        }
+        vtui->front_cursor.row = row;
+        vtui->front_cursor.col = col;
+        return _vtui_pushCmd(vtui, cmd_buf, bytes);
     } else {
         // no change
         return VTUI_OK;
@@ -489,41 +722,47 @@ int _vtui_vt_moveTo(vtui *vtui, int row, int col) {
 
 // set the foreground color to the specified 24-bit truecolor color
 int _vtui_vt_setFg(vtui *vtui, VTUI_BYTE r, VTUI_BYTE g, VTUI_BYTE b) {
-    const char *cmd_fmt = VTUI_CSI "38;2;%u;%u;%um";
-    char cmd_buf[32]; // oversized, to be safe
-    int bytes = vtui->snprintf(cmd_buf, 32, cmd_fmt, r, g, b);
-    if (bytes > 0 && bytes < 32) {
-        // string successfully written
-        return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
-    } else {
-        // failed to write formatted string
-        return VTUI_EFMT;
-    }
+    static const char cmd[] = VTUI_CSI "38;2;";
+    char cmd_buf[_VTUI_CSI_BYTES];
+    VTUI_SIZE bytes = _vtui_writeLit(cmd_buf, cmd, _vtui_lit_bytes(cmd));
+    bytes += _vtui_writeUint(&cmd_buf[bytes], r);
+    cmd_buf[bytes++] = ';';
+    bytes += _vtui_writeUint(&cmd_buf[bytes], g);
+    cmd_buf[bytes++] = ';';
+    bytes += _vtui_writeUint(&cmd_buf[bytes], b);
+    cmd_buf[bytes++] = 'm';
+    vtui->front_fg.red = r;
+    vtui->front_fg.green = g;
+    vtui->front_fg.blue = b;
+    return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
 }
 
 // set the background color to the specified 24-bit truecolor color
 int _vtui_vt_setBg(vtui *vtui, VTUI_BYTE r, VTUI_BYTE g, VTUI_BYTE b) {
-    const char *cmd_fmt = VTUI_CSI "38;2;%u;%u;%um";
-    char cmd_buf[32]; // oversized, to be safe
-    int bytes = vtui->snprintf(cmd_buf, 32, cmd_fmt, r, g, b);
-    if (bytes > 0 && bytes < 32) {
-        // string successfully written
-        return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
-    } else {
-        // failed to write formatted string
-        return VTUI_EFMT;
-    }
+    static const char cmd[] = VTUI_CSI "48;2;";
+    char cmd_buf[_VTUI_CSI_BYTES];
+    VTUI_SIZE bytes = _vtui_writeLit(cmd_buf, cmd, _vtui_lit_bytes(cmd));
+    bytes += _vtui_writeUint(&cmd_buf[bytes], r);
+    cmd_buf[bytes++] = ';';
+    bytes += _vtui_writeUint(&cmd_buf[bytes], g);
+    cmd_buf[bytes++] = ';';
+    bytes += _vtui_writeUint(&cmd_buf[bytes], b);
+    cmd_buf[bytes++] = 'm';
+    vtui->front_bg.red = r;
+    vtui->front_bg.green = g;
+    vtui->front_bg.blue = b;
+    return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
 }
 
 // push a single unicode codepoint to an update buffer
 int _vtui_vt_pushCodepoint(vtui *vtui, VTUI_UINT32 character) {
     const char *cmd_fmt = "%lc";
     char cmd_buf[32]; // way way way oversized, to be safe
-    int bytes = vtui->snprintf(cmd_buf, 32, cmd_fmt, character);
+    int bytes = _vtui_snprintf(vtui)(cmd_buf, 32, cmd_fmt, character);
     if (bytes > 0 && bytes < 32) {
         // string successfully written
         // TODO update cursor position!
-        return _vtui_pushSgrCmd(vtui, cmd_buf, bytes);
+        return _vtui_pushCmd(vtui, cmd_buf, bytes);
     } else {
         // failed to write formatted string
         return VTUI_EFMT;
@@ -542,11 +781,934 @@ int _vtui_vt_pushCodepoint(vtui *vtui, VTUI_UINT32 character) {
 // tabulation stops???
 // ???
 
+// ## VTUI PALETTE ROUTINES ##
+
+// pack a grapheme into a glyph id, NULL and empty graphemes are blanks
+VTUI_UINT32 _vtui_glyphId(const char *grapheme) {
+    VTUI_UINT32 id = 0;
+    int i;
+    if (grapheme == VTUI_NULL || grapheme[0] == VTUI_NUL[0]) {
+        return (VTUI_UINT32) ' ';
+    }
+    for (i = 0; grapheme[i] != VTUI_NUL[0]; i++) {
+        if (i == 4) {
+            return _VTUI_GLYPH_UNCACHED;
+        }
+        id |= ((VTUI_UINT32) (VTUI_BYTE) grapheme[i]) << (i * 8);
+    }
+    return id;
+}
+
+// compare the rgb components of two colors
+VTUI_BOOL _vtui_colorEq(vtui_color a, vtui_color b) {
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+// release the memory held by a grid's palette
+void _vtui_freePalette(vtui_grid *grid) {
+    if (grid->_palette.colors != VTUI_NULL) {
+        _vtui_free(grid)(grid->_palette.colors);
+    }
+    if (grid->_palette.slots != VTUI_NULL) {
+        _vtui_free(grid)(grid->_palette.slots);
+    }
+    if (grid->_palette_remap != VTUI_NULL) {
+        _vtui_free(grid)(grid->_palette_remap);
+    }
+    grid->_palette.colors = VTUI_NULL;
+    grid->_palette.slots = VTUI_NULL;
+    grid->_palette.count = 0;
+    grid->_palette.capacity = 0;
+    grid->_palette.slot_count = 0;
+    grid->_palette_remap = VTUI_NULL;
+    grid->_palette_remap_count = 0;
+}
+
+// key used to compare and hash colors, ignoring the unused byte
+VTUI_UINT32 _vtui_colorKey(vtui_color color) {
+    return ((VTUI_UINT32) color.red << 16) | ((VTUI_UINT32) color.green << 8)
+        | (VTUI_UINT32) color.blue;
+}
+
+// find the slot a color belongs in, either holding it already or empty
+VTUI_SIZE _vtui_paletteSlot(_vtui_palette *palette, VTUI_UINT32 key) {
+    VTUI_SIZE mask = palette->slot_count - 1;
+    VTUI_UINT32 hash = (key * 0x9E3779B1UL) & 0xFFFFFFFFUL;
+    VTUI_SIZE slot = (hash ^ (hash >> 15)) & mask;
+    while (palette->slots[slot] != 0 && _vtui_colorKey(
+        palette->colors[palette->slots[slot] - 1]) != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// get the palette index of a color, interning it if needed; returns
+// _VTUI_PALETTE_MAX if the palette is full or out of memory, which is still
+// safe to store in the planes, the cell will just always be redrawn
+VTUI_UINT16 _vtui_paletteIntern(vtui_grid *grid, vtui_color color) {
+    _vtui_palette *palette = &grid->_palette;
+    VTUI_UINT32 key = _vtui_colorKey(color);
+    VTUI_SIZE slot;
+    VTUI_SIZE i;
+    if (palette->slot_count > 0) {
+        slot = _vtui_paletteSlot(palette, key);
+        if (palette->slots[slot] != 0) {
+            return palette->slots[slot] - 1;
+        }
+    }
+    if (palette->count >= _VTUI_PALETTE_MAX - 1) {
+        return _VTUI_PALETTE_MAX;
+    }
+    if (palette->count == palette->capacity) {
+        // grow the colors -- grids have no realloc hook
+        VTUI_SIZE capacity = vtui_max(palette->capacity << 1, 16);
+        vtui_color *colors = (vtui_color *) _vtui_malloc(grid)(
+            capacity * sizeof(vtui_color));
+        if (colors == VTUI_NULL) {
+            return _VTUI_PALETTE_MAX;
+        }
+        for (i = 0; i < palette->count; i++) {
+            colors[i] = palette->colors[i];
+        }
+        if (palette->colors != VTUI_NULL) {
+            _vtui_free(grid)(palette->colors);
+        }
+        palette->colors = colors;
+        palette->capacity = capacity;
+    }
+    if ((palette->count + 1) * 2 > palette->slot_count) {
+        // grow the hash table, keeping it at most half full
+        VTUI_SIZE slot_count = vtui_max(palette->slot_count << 1, 64);
+        VTUI_UINT16 *slots = (VTUI_UINT16 *) _vtui_malloc(grid)(
+            slot_count * sizeof(VTUI_UINT16));
+        if (slots == VTUI_NULL) {
+            return _VTUI_PALETTE_MAX;
+        }
+        if (palette->slots != VTUI_NULL) {
+            _vtui_free(grid)(palette->slots);
+        }
+        palette->slots = slots;
+        palette->slot_count = slot_count;
+        for (i = 0; i < slot_count; i++) {
+            slots[i] = 0;
+        }
+        for (i = 0; i < palette->count; i++) {
+            slot = _vtui_paletteSlot(palette,
+                _vtui_colorKey(palette->colors[i]));
+            slots[slot] = (VTUI_UINT16) (i + 1);
+        }
+    }
+    slot = _vtui_paletteSlot(palette, key);
+    palette->colors[palette->count] = color;
+    palette->count++;
+    palette->slots[slot] = (VTUI_UINT16) palette->count;
+    return (VTUI_UINT16) (palette->count - 1);
+}
+
+// ## VTUI GRID ROUTINES ##
+
+// free a grid's cells, stamps and planes, whichever are allocated
+void _vtui_freeGrid(vtui_grid *grid) {
+    if (grid->cells != VTUI_NULL) {
+        _vtui_free(grid)(grid->cells);
+    }
+    if (grid->row_generation != VTUI_NULL) {
+        _vtui_free(grid)(grid->row_generation);
+    }
+    if (grid->_glyphs != VTUI_NULL) {
+        _vtui_free(grid)(grid->_glyphs);
+    }
+    if (grid->_fgs != VTUI_NULL) {
+        _vtui_free(grid)(grid->_fgs);
+    }
+    if (grid->_bgs != VTUI_NULL) {
+        _vtui_free(grid)(grid->_bgs);
+    }
+    if (grid->_interned_generation != VTUI_NULL) {
+        _vtui_free(grid)(grid->_interned_generation);
+    }
+    grid->cells = VTUI_NULL;
+    grid->row_generation = VTUI_NULL;
+    grid->_glyphs = VTUI_NULL;
+    grid->_fgs = VTUI_NULL;
+    grid->_bgs = VTUI_NULL;
+    grid->_interned_generation = VTUI_NULL;
+}
+
+// initialize a grid of the given size, filled with blank cells; the grid's
+// malloc and free must be set beforehand, unless VTUI_STATIC_HOOKS is defined.
+// can fail with VTUI_ENOMEM
+int vtui_grid_init(vtui_grid *grid, VTUI_AXIS rows, VTUI_AXIS cols) {
+    VTUI_SIZE cells = vtui_max((VTUI_SIZE) rows * cols, 1);
+    VTUI_SIZE i;
+    grid->cells = (vtui_cell *) _vtui_malloc(grid)(cells * sizeof(vtui_cell));
+    grid->row_generation = (VTUI_SIZE *) _vtui_malloc(grid)(
+        vtui_max(rows, 1) * sizeof(VTUI_SIZE));
+    grid->_glyphs = (VTUI_UINT32 *) _vtui_malloc(grid)(
+        cells * sizeof(VTUI_UINT32));
+    grid->_fgs = (VTUI_UINT16 *) _vtui_malloc(grid)(
+        cells * sizeof(VTUI_UINT16));
+    grid->_bgs = (VTUI_UINT16 *) _vtui_malloc(grid)(
+        cells * sizeof(VTUI_UINT16));
+    grid->_interned_generation = (VTUI_SIZE *) _vtui_malloc(grid)(
+        vtui_max(rows, 1) * sizeof(VTUI_SIZE));
+    if (grid->cells == VTUI_NULL || grid->row_generation == VTUI_NULL
+        || grid->_glyphs == VTUI_NULL || grid->_fgs == VTUI_NULL
+        || grid->_bgs == VTUI_NULL || grid->_interned_generation == VTUI_NULL) {
+        // give up if any allocation failed
+        _vtui_freeGrid(grid);
+        return VTUI_ENOMEM;
+    }
+    grid->rows = rows;
+    grid->cols = cols;
+    for (i = 0; i < (VTUI_SIZE) rows * cols; i++) {
+        grid->cells[i].grapheme = VTUI_NULL;
+        grid->cells[i].fg.color = 0;
+        grid->cells[i].bg.color = 0;
+    }
+    // every row starts out newer than any vtui that may draw it, and is yet
+    // to be interned
+    grid->generation = 1;
+    grid->resize_generation = grid->generation;
+    for (i = 0; i < rows; i++) {
+        grid->row_generation[i] = grid->generation;
+        grid->_interned_generation[i] = 0;
+    }
+    grid->_palette.colors = VTUI_NULL;
+    grid->_palette.count = 0;
+    grid->_palette.capacity = 0;
+    grid->_palette.slots = VTUI_NULL;
+    grid->_palette.slot_count = 0;
+    grid->_palette_generation = 0;
+    grid->_palette_live = 0;
+    grid->_palette_remap = VTUI_NULL;
+    grid->_palette_remap_count = 0;
+    return VTUI_OK;
+}
+
+// resize a grid, keeping the cells which overlap the old size, and filling
+// the rest with blank cells; every vtui drawing the grid rescans it at its
+// next update. can fail with VTUI_ENOMEM, leaving the grid untouched
+int vtui_grid_resize(vtui_grid *grid, VTUI_AXIS rows, VTUI_AXIS cols) {
+    vtui_grid old = *grid;
+    VTUI_AXIS row;
+    VTUI_AXIS col;
+    int err = vtui_grid_init(grid, rows, cols);
+    if (err != VTUI_OK) {
+        *grid = old;
+        return err;
+    }
+    for (row = 0; row < vtui_min(rows, old.rows); row++) {
+        for (col = 0; col < vtui_min(cols, old.cols); col++) {
+            grid->cells[(VTUI_SIZE) row * cols + col] =
+                old.cells[(VTUI_SIZE) row * old.cols + col];
+        }
+    }
+    // carry on counting from the old generation
+    grid->generation = old.generation + 1;
+    grid->resize_generation = grid->generation;
+    for (row = 0; row < rows; row++) {
+        grid->row_generation[row] = grid->generation;
+    }
+    // keep the palette, the front planes of every vtui drawing the grid still
+    // refer to it
+    grid->_palette = old._palette;
+    grid->_palette_generation = old._palette_generation;
+    grid->_palette_live = old._palette_live;
+    grid->_palette_remap = old._palette_remap;
+    grid->_palette_remap_count = old._palette_remap_count;
+    _vtui_freeGrid(&old);
+    return VTUI_OK;
+}
+
+// release the memory held by a grid
+void vtui_grid_release(vtui_grid *grid) {
+    _vtui_freeGrid(grid);
+    _vtui_freePalette(grid);
+    grid->rows = 0;
+    grid->cols = 0;
+}
+
+// mark a row of a grid as written, so that it is redrawn on every vtui
+// drawing the grid; only needed when cells are written to directly
+void vtui_grid_touch(vtui_grid *grid, VTUI_AXIS row) {
+    grid->generation++;
+    grid->row_generation[row] = grid->generation;
+}
+
+// get a writable pointer to a row of a grid, marking the row as written
+vtui_cell *vtui_grid_editRow(vtui_grid *grid, VTUI_AXIS row) {
+    vtui_grid_touch(grid, row);
+    return &grid->cells[(VTUI_SIZE) row * grid->cols];
+}
+
+// write a single cell of a grid, writes outside of the grid are clipped
+void vtui_grid_put(vtui_grid *grid, VTUI_AXIS row, VTUI_AXIS col,
+    vtui_cell cell) {
+    if (row < grid->rows && col < grid->cols) {
+        vtui_grid_editRow(grid, row)[col] = cell;
+    }
+}
+
+// intern a row of a grid into its planes; neighbouring cells mostly share
+// their colors, so each is only looked up when it differs from the last
+void _vtui_internRow(vtui_grid *grid, VTUI_AXIS row) {
+    VTUI_SIZE offset = (VTUI_SIZE) row * grid->cols;
+    const vtui_cell *cells = &grid->cells[offset];
+    VTUI_UINT32 fg_key = 0;
+    VTUI_UINT32 bg_key = 0;
+    VTUI_UINT16 fg = _VTUI_PALETTE_MAX;
+    VTUI_UINT16 bg = _VTUI_PALETTE_MAX;
+    VTUI_AXIS col;
+    for (col = 0; col < grid->cols; col++) {
+        VTUI_UINT32 key = _vtui_colorKey(cells[col].fg);
+        if (fg == _VTUI_PALETTE_MAX || key != fg_key) {
+            fg = _vtui_paletteIntern(grid, cells[col].fg);
+            fg_key = key;
+        }
+        key = _vtui_colorKey(cells[col].bg);
+        if (bg == _VTUI_PALETTE_MAX || key != bg_key) {
+            bg = _vtui_paletteIntern(grid, cells[col].bg);
+            bg_key = key;
+        }
+        grid->_glyphs[offset + col] = _vtui_glyphId(cells[col].grapheme);
+        grid->_fgs[offset + col] = fg;
+        grid->_bgs[offset + col] = bg;
+    }
+    grid->_interned_generation[row] = grid->row_generation[row];
+}
+
+// rebuild a grid's palette from only the colors its cells reference, keeping
+// a map from old indices to new ones for the front planes referring to it
+void _vtui_compactPalette(vtui_grid *grid) {
+    _vtui_palette *palette = &grid->_palette;
+    vtui_color *old_colors = palette->colors;
+    VTUI_SIZE old_count = palette->count;
+    VTUI_SIZE i;
+    VTUI_AXIS row;
+    if (grid->_palette_remap != VTUI_NULL) {
+        _vtui_free(grid)(grid->_palette_remap);
+    }
+    // start over with no colors, the old ones are kept until mapped
+    palette->colors = VTUI_NULL;
+    palette->count = 0;
+    palette->capacity = 0;
+    for (i = 0; i < palette->slot_count; i++) {
+        palette->slots[i] = 0;
+    }
+    for (row = 0; row < grid->rows; row++) {
+        _vtui_internRow(grid, row);
+    }
+    grid->_palette_remap = (VTUI_UINT16 *) _vtui_malloc(grid)(
+        vtui_max(old_count, 1) * sizeof(VTUI_UINT16));
+    grid->_palette_remap_count = 0;
+    if (grid->_palette_remap != VTUI_NULL) {
+        // without a map every vtui drawing the grid is redrawn whole
+        for (i = 0; i < old_count; i++) {
+            VTUI_SIZE slot;
+            grid->_palette_remap[i] = _VTUI_PALETTE_MAX;
+            if (palette->slot_count == 0) {
+                continue;
+            }
+            slot = _vtui_paletteSlot(palette, _vtui_colorKey(old_colors[i]));
+            if (palette->slots[slot] != 0) {
+                grid->_palette_remap[i] = palette->slots[slot] - 1;
+            }
+        }
+        grid->_palette_remap_count = old_count;
+    }
+    if (old_colors != VTUI_NULL) {
+        _vtui_free(grid)(old_colors);
+    }
+    grid->_palette_live = palette->count;
+    grid->_palette_generation++;
+}
+
+// intern every row of a grid written since it was last interned, compacting
+// the palette first if too many colors have come and gone
+void _vtui_internGrid(vtui_grid *grid) {
+    VTUI_AXIS row;
+    if (grid->_palette.count >= VTUI_PALETTE_RESET
+        && grid->_palette.count - grid->_palette_live
+            >= VTUI_PALETTE_RESET / 4) {
+        // every row is interned anew
+        _vtui_compactPalette(grid);
+        return;
+    }
+    for (row = 0; row < grid->rows; row++) {
+        if (grid->_interned_generation[row] != grid->row_generation[row]) {
+            _vtui_internRow(grid, row);
+        }
+    }
+}
+
 // ## VTUI RENDERING ROUTINES ##
 
-//
+// forget everything known about the state of the output, so that the next
+// update redraws every cell
+void _vtui_invalidateFront(vtui *vtui) {
+    VTUI_SIZE cells = (VTUI_SIZE) vtui->front_rows * vtui->front_cols;
+    VTUI_SIZE i;
+    for (i = 0; i < cells; i++) {
+        vtui->front_planes.glyphs[i] = _VTUI_GLYPH_INVALID;
+    }
+    vtui->front_cursor.row = VTUI_HYPERSPACE;
+    vtui->front_cursor.col = VTUI_HYPERSPACE;
+    vtui->front_colors_initalized = VTUI_FALSE;
+    vtui->front_valid = VTUI_FALSE;
+}
+
+// carry a front grid's colors over to its back grid's compacted palette;
+// cells whose colors were dropped from it are redrawn
+void _vtui_remapFront(vtui *vtui, const vtui_grid *grid) {
+    VTUI_SIZE cells = (VTUI_SIZE) vtui->front_rows * vtui->front_cols;
+    VTUI_SIZE i;
+    for (i = 0; i < cells; i++) {
+        VTUI_UINT16 fg = vtui->front_planes.fgs[i];
+        VTUI_UINT16 bg = vtui->front_planes.bgs[i];
+        fg = fg < grid->_palette_remap_count
+            ? grid->_palette_remap[fg] : _VTUI_PALETTE_MAX;
+        bg = bg < grid->_palette_remap_count
+            ? grid->_palette_remap[bg] : _VTUI_PALETTE_MAX;
+        vtui->front_planes.fgs[i] = fg;
+        vtui->front_planes.bgs[i] = bg;
+        if (fg == _VTUI_PALETTE_MAX || bg == _VTUI_PALETTE_MAX) {
+            vtui->front_planes.glyphs[i] = _VTUI_GLYPH_INVALID;
+        }
+    }
+}
+
+// allocate a set of front planes holding the given number of cells, can fail
+// with VTUI_ENOMEM
+int _vtui_allocPlanes(vtui *vtui, _vtui_front_planes *planes, VTUI_SIZE cells) {
+    (void) vtui; // only used by the hooks, unless VTUI_STATIC_HOOKS is defined
+    cells = vtui_max(cells, 1);
+    planes->glyphs = (VTUI_UINT32 *) _vtui_malloc(vtui)(
+        cells * sizeof(VTUI_UINT32));
+    planes->fgs = (VTUI_UINT16 *) _vtui_malloc(vtui)(
+        cells * sizeof(VTUI_UINT16));
+    planes->bgs = (VTUI_UINT16 *) _vtui_malloc(vtui)(
+        cells * sizeof(VTUI_UINT16));
+    if (planes->glyphs == VTUI_NULL || planes->fgs == VTUI_NULL
+        || planes->bgs == VTUI_NULL) {
+        // give up if any allocation failed
+        if (planes->glyphs != VTUI_NULL) {
+            _vtui_free(vtui)(planes->glyphs);
+        }
+        if (planes->fgs != VTUI_NULL) {
+            _vtui_free(vtui)(planes->fgs);
+        }
+        if (planes->bgs != VTUI_NULL) {
+            _vtui_free(vtui)(planes->bgs);
+        }
+        return VTUI_ENOMEM;
+    }
+    planes->capacity = cells;
+    return VTUI_OK;
+}
+
+// release a set of front planes
+void _vtui_freePlanes(vtui *vtui, _vtui_front_planes *planes) {
+    (void) vtui; // only used by the hooks, unless VTUI_STATIC_HOOKS is defined
+    if (planes->glyphs != VTUI_NULL) {
+        _vtui_free(vtui)(planes->glyphs);
+        _vtui_free(vtui)(planes->fgs);
+        _vtui_free(vtui)(planes->bgs);
+    }
+    planes->glyphs = VTUI_NULL;
+    planes->fgs = VTUI_NULL;
+    planes->bgs = VTUI_NULL;
+    planes->capacity = 0;
+}
+
+// initialize a vtui's state, before it is attached for the first time; its
+// fn pntrs and out_file are left alone, and may be set before or after
+void vtui_init(vtui *vtui) {
+    vtui->back = VTUI_NULL;
+    vtui->back_generation = 0;
+    vtui->cursor.row = VTUI_HYPERSPACE;
+    vtui->cursor.col = VTUI_HYPERSPACE;
+    vtui->cursor.invisible = VTUI_FALSE;
+    vtui->beep = VTUI_FALSE;
+    vtui->front_cursor = vtui->cursor;
+    vtui->front_fg.color = 0;
+    vtui->front_bg.color = 0;
+    vtui->front_colors_initalized = VTUI_FALSE;
+    vtui->front_planes.glyphs = VTUI_NULL;
+    vtui->front_planes.fgs = VTUI_NULL;
+    vtui->front_planes.bgs = VTUI_NULL;
+    vtui->front_planes.capacity = 0;
+    vtui->back_palette_generation = 0;
+    vtui->front_rows = 0;
+    vtui->front_cols = 0;
+    vtui->front_valid = VTUI_FALSE;
+    vtui->_resize_rows = 0;
+    vtui->_resize_cols = 0;
+    vtui->_resize_min_rows = 0;
+    vtui->_resize_min_cols = 0;
+    vtui->_resize_pending = VTUI_FALSE;
+    vtui->_buffer.text = VTUI_NULL;
+    vtui->_buffer.cur_bytes = 0;
+    vtui->_buffer.capacity = 0;
+    vtui->_buffer.sent = 0;
+    vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+}
+
+// attach a vtui to a back grid, allocating a front grid of the same size. the
+// vtui must have been initialized with vtui_init first; attaching an already
+// attached vtui moves it to the new grid. the grid may be shared with any
+// number of other vtuis, and is not owned by the vtui. the next update will be
+// a full redraw. can fail with VTUI_ENOMEM
+int vtui_attach(vtui *vtui, vtui_grid *back) {
+    _vtui_front_planes planes;
+    int err = _vtui_allocPlanes(vtui, &planes,
+        (VTUI_SIZE) back->rows * back->cols);
+    if (err != VTUI_OK) {
+        return err;
+    }
+    _vtui_freePlanes(vtui, &vtui->front_planes);
+    vtui->front_planes = planes;
+    vtui->front_rows = back->rows;
+    vtui->front_cols = back->cols;
+    vtui->back = back;
+    vtui->back_generation = 0;
+    vtui->back_palette_generation = back->_palette_generation;
+    _vtui_invalidateFront(vtui);
+    return VTUI_OK;
+}
+
+// detach a vtui from its back grid, releasing its front grid and buffer
+void vtui_detach(vtui *vtui) {
+    _vtui_freePlanes(vtui, &vtui->front_planes);
+    if (vtui->_buffer.text != VTUI_NULL) {
+        _vtui_free(vtui)(vtui->_buffer.text);
+    }
+    vtui->front_rows = 0;
+    vtui->front_cols = 0;
+    vtui->front_valid = VTUI_FALSE;
+    vtui->back = VTUI_NULL;
+    vtui->_buffer.text = VTUI_NULL;
+    vtui->_buffer.cur_bytes = 0;
+    vtui->_buffer.capacity = 0;
+    vtui->_buffer.sent = 0;
+    vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+}
+
+// drawn wherever the output extends past the edges of the back grid
+const vtui_cell _vtui_blank_cell = {
+    VTUI_NULL, {{{0, 0, 0, 0}}}, {{{0, 0, 0, 0}}}
+};
+
+// bytes of a grapheme packed into a glyph id -- utf8 never contains NUL bytes
+VTUI_SIZE _vtui_glyphBytes(VTUI_UINT32 glyph) {
+    if (glyph > 0xFFFFFF) {
+        return 4;
+    } else if (glyph > 0xFFFF) {
+        return 3;
+    } else if (glyph > 0xFF) {
+        return 2;
+    } else {
+        return 1;
+    }
+}
+
+// private view of a row of the back grid as drawn to a row of the output --
+// the row's planes, and its cells for what the planes cannot hold; cells past
+// the edges of the back grid are blank
+typedef struct _vtui_back_row {
+    const vtui_cell *cells;
+    const VTUI_UINT32 *glyphs;
+    const VTUI_UINT16 *fgs;
+    const VTUI_UINT16 *bgs;
+    VTUI_AXIS cols;    // columns of the output inside the back grid
+    VTUI_UINT16 blank; // palette index of the blank cell's colors
+} _vtui_back_row;
+
+VTUI_UINT32 _vtui_backGlyph(const _vtui_back_row *back, VTUI_AXIS col) {
+    return col < back->cols ? back->glyphs[col] : (VTUI_UINT32) ' ';
+}
+
+VTUI_UINT16 _vtui_backFg(const _vtui_back_row *back, VTUI_AXIS col) {
+    return col < back->cols ? back->fgs[col] : back->blank;
+}
+
+VTUI_UINT16 _vtui_backBg(const _vtui_back_row *back, VTUI_AXIS col) {
+    return col < back->cols ? back->bgs[col] : back->blank;
+}
+
+const vtui_cell *_vtui_backCell(const _vtui_back_row *back, VTUI_AXIS col) {
+    return col < back->cols ? &back->cells[col] : &_vtui_blank_cell;
+}
+
+// does a cell of the back grid differ from what is on the output; cells which
+// cannot be compared are stored in the front as invalid, so never match
+VTUI_BOOL _vtui_backChanged(vtui *vtui, const _vtui_back_row *back,
+    VTUI_SIZE offset, VTUI_AXIS col) {
+    return _vtui_backGlyph(back, col) != vtui->front_planes.glyphs[offset + col]
+        || _vtui_backFg(back, col) != vtui->front_planes.fgs[offset + col]
+        || _vtui_backBg(back, col) != vtui->front_planes.bgs[offset + col];
+}
+
+// unchanged cells a run may bridge, rather than breaking it in two; resending
+// this many single byte graphemes costs no more than a cursor movement
+#define _VTUI_RUN_GAP 4
+
+// draw a run of adjacent cells sharing the same colors, with a single cursor
+// movement, at most one sgr command, and one reservation of buffer space,
+// which the run's utf8 is then written straight into
+int _vtui_updateRun(vtui *vtui, VTUI_AXIS row, VTUI_AXIS start,
+    VTUI_AXIS end, const _vtui_back_row *back) {
+    VTUI_SIZE offset = (VTUI_SIZE) row * vtui->front_cols;
+    const vtui_cell *style = _vtui_backCell(back, start);
+    VTUI_UINT16 fg = _vtui_backFg(back, start);
+    VTUI_UINT16 bg = _vtui_backBg(back, start);
+    VTUI_BOOL comparable = fg != _VTUI_PALETTE_MAX && bg != _VTUI_PALETTE_MAX;
+    VTUI_SIZE bytes = 0;
+    VTUI_AXIS col;
+    char *text;
+    int err = _vtui_vt_moveTo(vtui, row + VTUI_HOME, start + VTUI_HOME);
+    if (err != VTUI_OK) {
+        return err;
+    }
+    if (!vtui->front_colors_initalized
+        || !_vtui_colorEq(style->fg, vtui->front_fg)) {
+        err = _vtui_vt_setFg(vtui, style->fg.red,
+            style->fg.green, style->fg.blue);
+        if (err != VTUI_OK) {
+            return err;
+        }
+    }
+    if (!vtui->front_colors_initalized
+        || !_vtui_colorEq(style->bg, vtui->front_bg)) {
+        err = _vtui_vt_setBg(vtui, style->bg.red,
+            style->bg.green, style->bg.blue);
+        if (err != VTUI_OK) {
+            return err;
+        }
+    }
+    vtui->front_colors_initalized = VTUI_TRUE;
+    // size up the run
+    for (col = start; col < end; col++) {
+        VTUI_UINT32 glyph = _vtui_backGlyph(back, col);
+        if (glyph != _VTUI_GLYPH_UNCACHED) {
+            bytes += _vtui_glyphBytes(glyph);
+        } else {
+            bytes += _vtui_strnt_bytes(back->cells[col].grapheme);
+        }
+    }
+    err = _vtui_reserveBytes(vtui, bytes);
+    if (err != VTUI_OK) {
+        return err;
+    }
+    text = &vtui->_buffer.text[vtui->_buffer.cur_bytes];
+    for (col = start; col < end; col++) {
+        VTUI_UINT32 glyph = _vtui_backGlyph(back, col);
+        if (glyph != _VTUI_GLYPH_UNCACHED) {
+            vtui->front_planes.glyphs[offset + col] =
+                comparable ? glyph : _VTUI_GLYPH_INVALID;
+            // unpack the glyph id
+            do {
+                *text++ = (char) (glyph & 0xFF);
+                glyph >>= 8;
+            } while (glyph != 0);
+        } else {
+            const char *grapheme = back->cells[col].grapheme;
+            VTUI_SIZE len = _vtui_strnt_bytes(grapheme);
+            vtui->front_planes.glyphs[offset + col] = _VTUI_GLYPH_INVALID;
+            _vtui_memcpy(vtui)(text, grapheme, len);
+            text += len;
+        }
+        vtui->front_planes.fgs[offset + col] = fg;
+        vtui->front_planes.bgs[offset + col] = bg;
+    }
+    vtui->_buffer.cur_bytes += bytes;
+    vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+    // TODO wide graphemes
+    vtui->front_cursor.col += end - start;
+    if (vtui->front_cursor.col > vtui->front_cols) {
+        // the cursor is left pending a wrap, which terminals disagree on the
+        // handling of -- send it off to hyperspace
+        vtui->front_cursor.col = VTUI_HYPERSPACE;
+    }
+    return VTUI_OK;
+}
+
+// draw every cell of a row that differs from the front grid, gathering them
+// into runs of cells sharing the same colors; the row is taken from the back
+// grid's planes if it has one, otherwise it is blank
+int _vtui_updateRow(vtui *vtui, VTUI_AXIS row) {
+    vtui_grid *grid = vtui->back;
+    VTUI_SIZE offset = (VTUI_SIZE) row * vtui->front_cols;
+    const VTUI_UINT32 *front_glyphs = &vtui->front_planes.glyphs[offset];
+    const VTUI_UINT16 *front_fgs = &vtui->front_planes.fgs[offset];
+    const VTUI_UINT16 *front_bgs = &vtui->front_planes.bgs[offset];
+    _vtui_back_row back;
+    VTUI_AXIS col = 0;
+    int err;
+    back.cells = VTUI_NULL;
+    back.glyphs = VTUI_NULL;
+    back.fgs = VTUI_NULL;
+    back.bgs = VTUI_NULL;
+    back.cols = 0;
+    back.blank = _VTUI_PALETTE_MAX;
+    if (row < grid->rows) {
+        VTUI_SIZE back_offset = (VTUI_SIZE) row * grid->cols;
+        back.cells = &grid->cells[back_offset];
+        back.glyphs = &grid->_glyphs[back_offset];
+        back.fgs = &grid->_fgs[back_offset];
+        back.bgs = &grid->_bgs[back_offset];
+        back.cols = vtui_min(grid->cols, vtui->front_cols);
+    }
+    if (back.cols < vtui->front_cols) {
+        back.blank = _vtui_paletteIntern(grid, _vtui_blank_cell.fg);
+    }
+    while (col < vtui->front_cols) {
+        VTUI_UINT16 fg;
+        VTUI_UINT16 bg;
+        VTUI_AXIS end;
+        VTUI_AXIS scan;
+        // skip unchanged cells, a dense scan of the planes
+        while (col < back.cols && back.glyphs[col] == front_glyphs[col]
+            && back.fgs[col] == front_fgs[col]
+            && back.bgs[col] == front_bgs[col]) {
+            col++;
+        }
+        if (col >= vtui->front_cols) {
+            break;
+        }
+        if (!_vtui_backChanged(vtui, &back, offset, col)) {
+            col++;
+            continue;
+        }
+        // extend the run over cells of the same colors, bridging short gaps
+        // of unchanged cells; colors that could not be interned are only
+        // known to match from their cells, so are drawn a cell at a time
+        fg = _vtui_backFg(&back, col);
+        bg = _vtui_backBg(&back, col);
+        end = col + 1;
+        for (scan = end; scan < vtui->front_cols
+            && fg != _VTUI_PALETTE_MAX && bg != _VTUI_PALETTE_MAX; scan++) {
+            if (_vtui_backFg(&back, scan) != fg
+                || _vtui_backBg(&back, scan) != bg) {
+                break;
+            }
+            if (_vtui_backChanged(vtui, &back, offset, scan)) {
+                end = scan + 1;
+            } else if (scan - end >= _VTUI_RUN_GAP) {
+                break;
+            }
+        }
+        err = _vtui_updateRun(vtui, row, col, end, &back);
+        if (err != VTUI_OK) {
+            return err;
+        }
+        col = end;
+    }
+    return VTUI_OK;
+}
+
+// resize the output of a vtui; the resize is applied at the next update, so
+// a burst of resizes is only ever drawn once, at the final size
+void vtui_resize(vtui *vtui, VTUI_AXIS rows, VTUI_AXIS cols) {
+    if (!vtui->_resize_pending) {
+        vtui->_resize_min_rows = vtui->front_rows;
+        vtui->_resize_min_cols = vtui->front_cols;
+    }
+    // anything cut off by an intermediate size is lost, even if the final
+    // size brings it back
+    vtui->_resize_min_rows = vtui_min(vtui->_resize_min_rows, rows);
+    vtui->_resize_min_cols = vtui_min(vtui->_resize_min_cols, cols);
+    vtui->_resize_rows = rows;
+    vtui->_resize_cols = cols;
+    vtui->_resize_pending = VTUI_TRUE;
+}
+
+// apply a pending resize to the front grid, keeping what is known about the
+// part of the output that survived every size in the burst. terminals keep the
+// top left of the screen in place as long as the cursor stays on screen,
+// otherwise they scroll, so the rest of the screen is only trusted in the
+// first case. can fail with VTUI_ENOMEM, in which case the front grid is left
+// untouched
+int _vtui_applyResize(vtui *vtui) {
+    VTUI_AXIS rows = vtui->_resize_rows;
+    VTUI_AXIS cols = vtui->_resize_cols;
+    VTUI_AXIS old_cols = vtui->front_cols;
+    VTUI_AXIS keep_rows = vtui->_resize_min_rows;
+    VTUI_AXIS keep_cols = vtui->_resize_min_cols;
+    VTUI_SIZE cells = vtui_max((VTUI_SIZE) rows * cols, 1);
+    _vtui_front_planes *front = &vtui->front_planes;
+    VTUI_AXIS row;
+    VTUI_AXIS col;
+    if (cols == old_cols) {
+        // rows are laid out the same, grow in place if needed
+        if (cells > front->capacity) {
+            void *pntr = _vtui_realloc(vtui)(
+                front->glyphs, cells * sizeof(VTUI_UINT32));
+            if (pntr == VTUI_NULL) {
+                return VTUI_ENOMEM;
+            }
+            front->glyphs = (VTUI_UINT32 *) pntr;
+            pntr = _vtui_realloc(vtui)(front->fgs, cells * sizeof(VTUI_UINT16));
+            if (pntr == VTUI_NULL) {
+                return VTUI_ENOMEM;
+            }
+            front->fgs = (VTUI_UINT16 *) pntr;
+            pntr = _vtui_realloc(vtui)(front->bgs, cells * sizeof(VTUI_UINT16));
+            if (pntr == VTUI_NULL) {
+                return VTUI_ENOMEM;
+            }
+            front->bgs = (VTUI_UINT16 *) pntr;
+            front->capacity = cells;
+        }
+    } else {
+        _vtui_front_planes planes;
+        int err = _vtui_allocPlanes(vtui, &planes, cells);
+        if (err != VTUI_OK) {
+            return err;
+        }
+        // copy over the overlapping part of each row
+        for (row = 0; row < keep_rows; row++) {
+            VTUI_SIZE dst = (VTUI_SIZE) row * cols;
+            VTUI_SIZE src = (VTUI_SIZE) row * old_cols;
+            _vtui_memcpy(vtui)(&planes.glyphs[dst], &front->glyphs[src],
+                keep_cols * sizeof(VTUI_UINT32));
+            _vtui_memcpy(vtui)(&planes.fgs[dst], &front->fgs[src],
+                keep_cols * sizeof(VTUI_UINT16));
+            _vtui_memcpy(vtui)(&planes.bgs[dst], &front->bgs[src],
+                keep_cols * sizeof(VTUI_UINT16));
+        }
+        _vtui_freePlanes(vtui, front);
+        *front = planes;
+    }
+    // whatever was not on screen the whole time is unknown
+    for (row = 0; row < rows; row++) {
+        for (col = row < keep_rows ? keep_cols : 0; col < cols; col++) {
+            front->glyphs[(VTUI_SIZE) row * cols + col] = _VTUI_GLYPH_INVALID;
+        }
+    }
+    vtui->front_rows = rows;
+    vtui->front_cols = cols;
+    vtui->_resize_pending = VTUI_FALSE;
+    if (vtui->front_cursor.row == VTUI_HYPERSPACE
+        || vtui->front_cursor.row > keep_rows) {
+        // the terminal may have scrolled to keep the cursor on screen
+        _vtui_invalidateFront(vtui);
+    }
+    // terminals clamp the cursor, no telling where it ended up
+    vtui->front_cursor.row = VTUI_HYPERSPACE;
+    vtui->front_cursor.col = VTUI_HYPERSPACE;
+    // rescan every row, not just the ones written to since the last update
+    vtui->back_generation = 0;
+    return VTUI_OK;
+}
+
+// draw the back grid to the output, sending only the cells that differ from
+// the front grid, unless full_redraw is set. every vtui sharing a back grid
+// keeps its own front, so a lagging or reconnected output can be resynced
+// with a full redraw without affecting the others. returns VTUI_EAGAIN if the
+// output could not take the whole update, see vtui_flush. on error the output
+// is left in an unknown state, and the next update will be a full redraw
 int vtui_update(vtui *vtui, VTUI_BOOL full_redraw) {
+    vtui_grid *back = vtui->back;
+    VTUI_SIZE generation;
+    VTUI_BOOL all_rows;
+    VTUI_AXIS row;
+    VTUI_SIZE start = vtui->_buffer.cur_bytes;
+    int err = VTUI_OK;
+    if (back == VTUI_NULL || vtui->front_planes.glyphs == VTUI_NULL) {
+        return VTUI_EWRONGSTATE;
+    }
+    // never fuse into a command left pending by an earlier update
+    vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+    if (vtui->_resize_pending) {
+        err = _vtui_applyResize(vtui);
+        if (err != VTUI_OK) {
+            return err;
+        }
+    }
+    // bring the back grid's planes up to date, shared by every vtui drawing it
+    _vtui_internGrid(back);
+    if (vtui->back_palette_generation != back->_palette_generation) {
+        if (vtui->back_palette_generation + 1 == back->_palette_generation
+            && back->_palette_remap != VTUI_NULL) {
+            _vtui_remapFront(vtui, back);
+        } else {
+            // the front's palette indices no longer mean anything
+            _vtui_invalidateFront(vtui);
+        }
+        vtui->back_palette_generation = back->_palette_generation;
+    }
+    generation = back->generation;
+    all_rows = full_redraw || !vtui->front_valid;
+    if (all_rows) {
+        _vtui_invalidateFront(vtui);
+        err = _vtui_vt_resetSgr(vtui);
+    }
+    // draw each row which has been written since the last update, rows past
+    // the end of the back grid only need checking once it has been resized
+    for (row = 0; row < vtui->front_rows && err == VTUI_OK; row++) {
+        if (all_rows || (row < back->rows
+            ? back->row_generation[row] > vtui->back_generation
+            : back->resize_generation > vtui->back_generation)) {
+            err = _vtui_updateRow(vtui, row);
+        }
+    }
+    // leave the cursor where it was asked to be
+    if (err == VTUI_OK && vtui->cursor.row != VTUI_HYPERSPACE
+        && vtui->cursor.col != VTUI_HYPERSPACE) {
+        err = _vtui_vt_moveTo(vtui, vtui->cursor.row, vtui->cursor.col);
+    }
+    if (err == VTUI_OK
+        && (all_rows
+            || vtui->cursor.invisible != vtui->front_cursor.invisible)) {
+        if (vtui->cursor.invisible) {
+            err = _vtui_vt_hideCursor(vtui);
+        } else {
+            err = _vtui_vt_showCursor(vtui);
+        }
+    }
+    if (err == VTUI_OK && vtui->beep) {
+        err = _vtui_vt_beep(vtui);
+    }
+    if (err == VTUI_OK) {
+        err = _vtui_flush(vtui);
+        if (err == VTUI_EIO) {
+            // the output is in an unknown state, drop everything unsent
+            vtui->_buffer.cur_bytes = 0;
+            vtui->_buffer.sent = 0;
+        }
+    } else {
+        // drop this update, but not what is pending from earlier ones
+        vtui->_buffer.cur_bytes = start;
+    }
+    if (err == VTUI_OK || err == VTUI_EAGAIN) {
+        // the update is complete, even if some of it is still pending
+        vtui->back_generation = generation;
+        vtui->front_valid = VTUI_TRUE;
+    } else {
+        // resync next time
+        vtui->_buffer.state = _vtui_update_buffer_state_last_cmd_was_not_sgr;
+        _vtui_invalidateFront(vtui);
+    }
+    return err;
+}
+
+// write out whatever is left pending by an update, for use with non-blocking
+// outputs. returns VTUI_EAGAIN if some is still left pending; can fail with
+// VTUI_EIO, after which the next update will be a full redraw
+int vtui_flush(vtui *vtui) {
+    int err = _vtui_flush(vtui);
+    if (err == VTUI_EIO) {
+        vtui->_buffer.cur_bytes = 0;
+        vtui->_buffer.sent = 0;
+        _vtui_invalidateFront(vtui);
+    }
+    return err;
+}
 
+// bytes of output left pending by an update
+VTUI_SIZE vtui_pendingBytes(vtui *vtui) {
+    return vtui->_buffer.cur_bytes - vtui->_buffer.sent;
 }
 
 //TODO
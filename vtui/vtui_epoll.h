@@ -0,0 +1,508 @@
+// vtui epoll -- optional linux event loop driving many vtuis from one thread
+
+/*
+The Clear BSD License
+
+Copyright (c) 2021 Valyrie Autumn
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted (subject to the limitations in the disclaimer
+below) provided that the following conditions are met:
+
+     * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+     * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+
+     * Neither the name of the copyright holder nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef vtui_epoll_h
+#define vtui_epoll_h
+
+// a vtui_epoll owns the input and output fds of any number of vtuis (heads),
+// all of which are switched to non-blocking mode. input is read as it
+// arrives and handed to a callback, output is only written when the fd is
+// ready for it, and partial writes are resumed where they left off. frames
+// are paced by a timerfd which is only armed when woken, so an idle reactor
+// never wakes up. a head which still has output pending when a frame comes
+// around is skipped, and catches up in one update once its output drains.
+
+// vtui_epoll_run handles a single batch of events, and the epoll fd itself
+// can be polled, so a reactor can be nested inside another event loop.
+
+// linux only; needs POSIX.1-2008 (define _POSIX_C_SOURCE or _GNU_SOURCE when
+// compiling with a strict -std). vtui_epoll installs its own write hook, if
+// VTUI_STATIC_HOOKS is defined, define VTUI_WRITE as vtui_epoll_write.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vtui_macros.h"
+
+// write hook used by vtui_epoll heads, declared ahead of vtui.h so that it can
+// be used as VTUI_WRITE
+int vtui_epoll_write(void *file, const char *buf, VTUI_SIZE bytes);
+
+#include "vtui.h"
+
+// ## VTUI EPOLL MACROS ##
+
+// bytes read from an input fd at a time
+
+#ifndef VTUI_EPOLL_READ_BYTES
+
+#define VTUI_EPOLL_READ_BYTES 4096
+
+#endif
+
+// events handled per call to vtui_epoll_run
+
+#ifndef VTUI_EPOLL_EVENTS
+
+#define VTUI_EPOLL_EVENTS 64
+
+#endif
+
+// roles of a registered fd
+#define _VTUI_EPOLL_IN 1
+#define _VTUI_EPOLL_OUT 2
+
+// ## VTUI EPOLL TYPEDEFS ##
+
+typedef struct vtui_epoll vtui_epoll;
+typedef struct vtui_epoll_head vtui_epoll_head;
+
+// called with bytes read from a head's input
+typedef void (vtui_epoll_input)(vtui_epoll_head *head, const char *buf,
+    VTUI_SIZE bytes);
+
+// called when a head's input reaches end of file (err is VTUI_OK), or either
+// of its fds fails (err is VTUI_EIO); the head has already been removed from
+// its reactor by the time this is called, its fds are left open
+typedef void (vtui_epoll_hangup)(vtui_epoll_head *head, int err);
+
+// called at the start of every frame, before any head is updated -- the place
+// to compose shared grids; call vtui_epoll_wake to ask for another frame
+typedef void (vtui_epoll_frame)(vtui_epoll *ep);
+
+// private fd registration -- a head has one per distinct fd
+typedef struct _vtui_epoll_fd {
+    vtui_epoll_head *head;
+    int fd;
+    int roles;
+    VTUI_UINT32 events; // events currently registered with epoll
+} _vtui_epoll_fd;
+
+struct vtui_epoll_head {
+    // variables, set before adding the head
+
+    vtui *ui;
+    int in_fd;  // may be the same as out_fd
+    int out_fd;
+    vtui_epoll_input *on_input;   // may be NULL
+    vtui_epoll_hangup *on_hangup; // may be NULL
+    void *user;
+
+    // private variables
+
+    vtui_epoll *_ep;
+    _vtui_epoll_fd _in;
+    _vtui_epoll_fd _out; // unused if in_fd == out_fd
+    VTUI_BOOL _in_open;
+    VTUI_BOOL _resync;
+    vtui_epoll_head *_prev;
+    vtui_epoll_head *_next;
+};
+
+struct vtui_epoll {
+    // variables
+
+    vtui_epoll_frame *on_frame; // may be NULL
+    void *user;
+
+    // private variables
+
+    int _epfd;
+    int _timerfd;
+    long _frame_ns;
+    VTUI_BOOL _timer_armed;
+    struct timespec _last_frame;
+    vtui_epoll_head *_heads;
+    vtui_epoll_head *_cursor; // next head to visit while drawing a frame
+};
+
+// ## VTUI EPOLL ROUTINES ##
+
+int vtui_epoll_write(void *file, const char *buf, VTUI_SIZE bytes) {
+    vtui_epoll_head *head = (vtui_epoll_head *) file;
+    ssize_t written;
+    // keep the byte count representable in the return value
+    bytes = vtui_min(bytes, (VTUI_SIZE) 0x7FFFFFFF);
+    written = write(head->out_fd, buf, bytes);
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            // not ready, try again once it is
+            return 0;
+        }
+        return -1;
+    }
+    return (int) written;
+}
+
+// initialize a reactor which draws at most one frame every frame_ns
+// nanoseconds; can fail with VTUI_EIO
+int vtui_epoll_init(vtui_epoll *ep, long frame_ns) {
+    struct epoll_event event;
+    ep->_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (ep->_epfd < 0) {
+        return VTUI_EIO;
+    }
+    ep->_timerfd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ep->_timerfd < 0) {
+        close(ep->_epfd);
+        return VTUI_EIO;
+    }
+    // the timer is told apart from heads by pointing at the reactor itself
+    event.events = EPOLLIN;
+    event.data.ptr = ep;
+    if (epoll_ctl(ep->_epfd, EPOLL_CTL_ADD, ep->_timerfd, &event) < 0) {
+        close(ep->_timerfd);
+        close(ep->_epfd);
+        return VTUI_EIO;
+    }
+    ep->_frame_ns = frame_ns;
+    ep->_timer_armed = VTUI_FALSE;
+    ep->_last_frame.tv_sec = 0;
+    ep->_last_frame.tv_nsec = 0;
+    ep->_heads = VTUI_NULL;
+    ep->_cursor = VTUI_NULL;
+    return VTUI_OK;
+}
+
+// release a reactor, removing every head from it
+void vtui_epoll_release(vtui_epoll *ep) {
+    while (ep->_heads != VTUI_NULL) {
+        vtui_epoll_head *head = ep->_heads;
+        ep->_heads = head->_next;
+        head->_ep = VTUI_NULL;
+    }
+    close(ep->_timerfd);
+    close(ep->_epfd);
+}
+
+// the epoll fd of a reactor, readable whenever vtui_epoll_run has work to do
+int vtui_epoll_fd(vtui_epoll *ep) {
+    return ep->_epfd;
+}
+
+// ask for a frame to be drawn; frames are never drawn closer together than the
+// reactor's frame interval, and waking an already woken reactor does nothing
+void vtui_epoll_wake(vtui_epoll *ep) {
+    struct itimerspec deadline;
+    if (ep->_timer_armed) {
+        return;
+    }
+    deadline.it_interval.tv_sec = 0;
+    deadline.it_interval.tv_nsec = 0;
+    deadline.it_value = ep->_last_frame;
+    deadline.it_value.tv_nsec += ep->_frame_ns;
+    deadline.it_value.tv_sec += deadline.it_value.tv_nsec / 1000000000L;
+    deadline.it_value.tv_nsec %= 1000000000L;
+    if (deadline.it_value.tv_sec == 0 && deadline.it_value.tv_nsec == 0) {
+        // a zero deadline would disarm the timer
+        deadline.it_value.tv_nsec = 1;
+    }
+    // deadlines in the past fire right away
+    if (timerfd_settime(ep->_timerfd, TFD_TIMER_ABSTIME, &deadline,
+        VTUI_NULL) == 0) {
+        ep->_timer_armed = VTUI_TRUE;
+    }
+}
+
+// change the events an fd is registered for
+int _vtui_epoll_watch(vtui_epoll *ep, _vtui_epoll_fd *efd,
+    VTUI_UINT32 events) {
+    struct epoll_event event;
+    if (efd->events == events) {
+        return VTUI_OK;
+    }
+    event.events = events;
+    event.data.ptr = efd;
+    if (epoll_ctl(ep->_epfd, EPOLL_CTL_MOD, efd->fd, &event) < 0) {
+        return VTUI_EIO;
+    }
+    efd->events = events;
+    return VTUI_OK;
+}
+
+// register one of a head's fds
+int _vtui_epoll_register(vtui_epoll *ep, vtui_epoll_head *head,
+    _vtui_epoll_fd *efd, int fd, int roles) {
+    struct epoll_event event;
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return VTUI_EIO;
+    }
+    efd->head = head;
+    efd->fd = fd;
+    efd->roles = roles;
+    efd->events = roles & _VTUI_EPOLL_IN ? (VTUI_UINT32) EPOLLIN : 0;
+    event.events = efd->events;
+    event.data.ptr = efd;
+    if (epoll_ctl(ep->_epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return VTUI_EIO;
+    }
+    return VTUI_OK;
+}
+
+// add a head to a reactor; its vtui must already be attached to a grid, and
+// its fds are switched to non-blocking mode. the first frame drawn to it is a
+// full redraw. can fail with VTUI_EIO
+int vtui_epoll_add(vtui_epoll *ep, vtui_epoll_head *head) {
+    int err;
+    if (head->in_fd == head->out_fd) {
+        err = _vtui_epoll_register(ep, head, &head->_in, head->in_fd,
+            _VTUI_EPOLL_IN | _VTUI_EPOLL_OUT);
+    } else {
+        err = _vtui_epoll_register(ep, head, &head->_in, head->in_fd,
+            _VTUI_EPOLL_IN);
+        if (err == VTUI_OK) {
+            err = _vtui_epoll_register(ep, head, &head->_out, head->out_fd,
+                _VTUI_EPOLL_OUT);
+            if (err != VTUI_OK) {
+                epoll_ctl(ep->_epfd, EPOLL_CTL_DEL, head->in_fd, VTUI_NULL);
+            }
+        }
+    }
+    if (err != VTUI_OK) {
+        return err;
+    }
+#ifndef VTUI_STATIC_HOOKS
+    head->ui->write = vtui_epoll_write;
+#endif
+    head->ui->out_file = head;
+    head->_ep = ep;
+    head->_in_open = VTUI_TRUE;
+    head->_resync = VTUI_TRUE;
+    head->_prev = VTUI_NULL;
+    head->_next = ep->_heads;
+    if (ep->_heads != VTUI_NULL) {
+        ep->_heads->_prev = head;
+    }
+    ep->_heads = head;
+    vtui_epoll_wake(ep);
+    return VTUI_OK;
+}
+
+// remove a head from its reactor, leaving its fds open; safe to call from
+// within callbacks, but the head must stay allocated until vtui_epoll_run
+// returns
+void vtui_epoll_remove(vtui_epoll_head *head) {
+    vtui_epoll *ep = head->_ep;
+    if (ep == VTUI_NULL) {
+        return;
+    }
+    epoll_ctl(ep->_epfd, EPOLL_CTL_DEL, head->in_fd, VTUI_NULL);
+    if (head->in_fd != head->out_fd) {
+        epoll_ctl(ep->_epfd, EPOLL_CTL_DEL, head->out_fd, VTUI_NULL);
+    }
+    if (ep->_cursor == head) {
+        ep->_cursor = head->_next;
+    }
+    if (head->_prev != VTUI_NULL) {
+        head->_prev->_next = head->_next;
+    } else {
+        ep->_heads = head->_next;
+    }
+    if (head->_next != VTUI_NULL) {
+        head->_next->_prev = head->_prev;
+    }
+    head->_ep = VTUI_NULL;
+}
+
+// redraw a head in full at the next frame, e.g. after its client reconnects
+void vtui_epoll_resync(vtui_epoll_head *head) {
+    head->_resync = VTUI_TRUE;
+    if (head->_ep != VTUI_NULL) {
+        vtui_epoll_wake(head->_ep);
+    }
+}
+
+// registration of a head's output fd
+_vtui_epoll_fd *_vtui_epoll_outFd(vtui_epoll_head *head) {
+    return head->in_fd == head->out_fd ? &head->_in : &head->_out;
+}
+
+// report a failed head, removing it from its reactor
+void _vtui_epoll_hangup(vtui_epoll_head *head, int err) {
+    vtui_epoll_remove(head);
+    if (head->on_hangup != VTUI_NULL) {
+        head->on_hangup(head, err);
+    }
+}
+
+// does a head have anything new to draw
+VTUI_BOOL _vtui_epoll_stale(vtui_epoll_head *head) {
+    vtui *vtui = head->ui;
+    return head->_resync || vtui->_resize_pending || !vtui->front_valid
+        || vtui->back->generation != vtui->back_generation;
+}
+
+// watch a head's output fd for readiness only while it has output pending
+int _vtui_epoll_watchOutput(vtui_epoll_head *head) {
+    _vtui_epoll_fd *efd = _vtui_epoll_outFd(head);
+    VTUI_UINT32 events = 0;
+    if (efd->roles & _VTUI_EPOLL_IN && head->_in_open) {
+        events |= EPOLLIN;
+    }
+    if (vtui_pendingBytes(head->ui) > 0) {
+        events |= EPOLLOUT;
+    }
+    return _vtui_epoll_watch(head->_ep, efd, events);
+}
+
+// read whatever input a head has ready
+void _vtui_epoll_read(vtui_epoll_head *head) {
+    char buf[VTUI_EPOLL_READ_BYTES];
+    ssize_t got;
+    do {
+        got = read(head->in_fd, buf, VTUI_EPOLL_READ_BYTES);
+    } while (got < 0 && errno == EINTR);
+    if (got > 0) {
+        if (head->on_input != VTUI_NULL) {
+            head->on_input(head, buf, (VTUI_SIZE) got);
+        }
+    } else if (got == 0) {
+        // end of file
+        head->_in_open = VTUI_FALSE;
+        _vtui_epoll_hangup(head, VTUI_OK);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        _vtui_epoll_hangup(head, VTUI_EIO);
+    }
+}
+
+// resume writing a head's pending output
+void _vtui_epoll_drain(vtui_epoll_head *head) {
+    int err = vtui_flush(head->ui);
+    if (err == VTUI_OK) {
+        // drained, stop watching for readiness and catch up if needed
+        if (_vtui_epoll_watchOutput(head) != VTUI_OK) {
+            _vtui_epoll_hangup(head, VTUI_EIO);
+        } else if (_vtui_epoll_stale(head)) {
+            vtui_epoll_wake(head->_ep);
+        }
+    } else if (err != VTUI_EAGAIN) {
+        _vtui_epoll_hangup(head, err);
+    }
+}
+
+// draw a frame, updating every head with something new to draw
+void _vtui_epoll_frame(vtui_epoll *ep) {
+    unsigned char expirations[8];
+    // clear the timer's readiness, the count itself doesn't matter
+    while (read(ep->_timerfd, expirations, sizeof(expirations)) < 0
+        && errno == EINTR) {
+    }
+    ep->_timer_armed = VTUI_FALSE;
+    clock_gettime(CLOCK_MONOTONIC, &ep->_last_frame);
+    if (ep->on_frame != VTUI_NULL) {
+        ep->on_frame(ep);
+    }
+    // heads may be removed by callbacks along the way, see vtui_epoll_remove
+    ep->_cursor = ep->_heads;
+    while (ep->_cursor != VTUI_NULL) {
+        vtui_epoll_head *head = ep->_cursor;
+        VTUI_BOOL full_redraw = head->_resync;
+        int err;
+        ep->_cursor = head->_next;
+        if (vtui_pendingBytes(head->ui) > 0 || !_vtui_epoll_stale(head)) {
+            // nothing to do, or still busy with an earlier frame
+            continue;
+        }
+        head->_resync = VTUI_FALSE;
+        err = vtui_update(head->ui, full_redraw);
+        if (err == VTUI_EAGAIN) {
+            // the rest goes out once the output is ready for it
+            if (_vtui_epoll_watchOutput(head) != VTUI_OK) {
+                _vtui_epoll_hangup(head, VTUI_EIO);
+            }
+        } else if (err == VTUI_ENOMEM) {
+            // try again next frame
+            head->_resync = full_redraw;
+            vtui_epoll_wake(ep);
+        } else if (err != VTUI_OK) {
+            _vtui_epoll_hangup(head, err);
+        }
+    }
+}
+
+// wait up to timeout_ms milliseconds (-1 waits forever, 0 not at all) for
+// events, and handle a single batch of them; input is handled before the
+// frame, so it can be drawn in the same batch. can fail with VTUI_EIO
+int vtui_epoll_run(vtui_epoll *ep, int timeout_ms) {
+    struct epoll_event events[VTUI_EPOLL_EVENTS];
+    VTUI_BOOL frame = VTUI_FALSE;
+    int count = epoll_wait(ep->_epfd, events, VTUI_EPOLL_EVENTS, timeout_ms);
+    int i;
+    if (count < 0) {
+        return errno == EINTR ? VTUI_OK : VTUI_EIO;
+    }
+    for (i = 0; i < count; i++) {
+        _vtui_epoll_fd *efd;
+        vtui_epoll_head *head;
+        if (events[i].data.ptr == ep) {
+            frame = VTUI_TRUE;
+            continue;
+        }
+        efd = (_vtui_epoll_fd *) events[i].data.ptr;
+        head = efd->head;
+        if (head->_ep != ep) {
+            // removed earlier in this batch
+            continue;
+        }
+        if (events[i].events & EPOLLERR) {
+            _vtui_epoll_hangup(head, VTUI_EIO);
+            continue;
+        }
+        if (efd->roles & _VTUI_EPOLL_IN
+            && events[i].events & (EPOLLIN | EPOLLHUP)) {
+            // a hangup reads as end of file
+            _vtui_epoll_read(head);
+        } else if (events[i].events & EPOLLHUP) {
+            _vtui_epoll_hangup(head, VTUI_EIO);
+        }
+        if (head->_ep == ep && events[i].events & EPOLLOUT) {
+            _vtui_epoll_drain(head);
+        }
+    }
+    if (frame) {
+        _vtui_epoll_frame(ep);
+    }
+    return VTUI_OK;
+}
+
+#endif
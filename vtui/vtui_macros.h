@@ -86,6 +86,30 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 #endif
 
+// ## UINT16 TYPE ##
+
+// the palette indices vtui keeps for each cell of the screen are 16 bits wide,
+// as with the 32 bit types, <stdint.h> is used if available, otherwise it falls
+// back to unsigned short int, which is at least 16 bits in size.
+
+#ifndef VTUI_UINT16
+
+// first check for C99 support
+#if __STDC_VERSION__ >= 199901L
+
+#include <stdint.h>
+
+#define VTUI_UINT16 uint16_t
+
+#else
+// no C99 support, fallback to short int
+
+// guranteed to be at least 16 bits
+#define VTUI_UINT16 unsigned short int
+
+#endif
+#endif
+
 // ## VTUI SIZE TYPE ##
 
 // much like vtui_int32 and vtui_uint32, vtui needs a size_t; override this
@@ -205,5 +229,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #define VTUI_EIO         -2 // generic i/o error
 #define VTUI_EWRONGSTATE -3 // the provided vtui is in the wrong state
 #define VTUI_EFMT        -4 // an error occurred while formatting a string
+#define VTUI_EAGAIN      -5 // output would block, the rest is still pending
 
 #endif
\ No newline at end of file
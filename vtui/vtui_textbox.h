@@ -0,0 +1,626 @@
+// vtui textbox -- a scrolling, wrapping view of an append-only log of lines
+
+/*
+The Clear BSD License
+
+Copyright (c) 2021 Valyrie Autumn
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted (subject to the limitations in the disclaimer
+below) provided that the following conditions are met:
+
+     * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+     * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+
+     * Neither the name of the copyright holder nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef vtui_textbox_h
+#define vtui_textbox_h
+
+#include "vtui.h"
+
+// a vtui_textbox stores its lines in a ring of fixed-size chunks, and keeps at
+// most max_lines lines in at most max_chunks chunks -- once either is full, the
+// oldest lines are evicted. memory use is bounded, and chunks are recycled
+// rather than freed, so a busy log does not churn the allocator.
+
+// each line's height when wrapped is kept in a fenwick tree, so the line
+// holding any given visual row can be found in O(log n). appending a line
+// only wraps that line; when the width changes nothing is rewrapped up front,
+// instead lines are rewrapped as they are drawn, so only the lines around the
+// viewport are ever touched. heights of lines far from the viewport may be
+// stale, which only affects how far a scroll by a given number of rows lands.
+
+// TODO wide graphemes / grapheme clusters -- one codepoint per cell for now
+
+// ## VTUI TEXTBOX MACROS ##
+
+// size of a single chunk of line text; also the longest line a textbox can
+// store, longer lines are truncated
+
+#ifndef VTUI_TEXTBOX_CHUNK_BYTES
+
+#define VTUI_TEXTBOX_CHUNK_BYTES 65536
+
+#endif
+
+// bytes of scratch per drawn cell -- one utf8 codepoint and a terminator
+#define _VTUI_TEXTBOX_GLYPH_BYTES 5
+
+// ## VTUI TEXTBOX TYPEDEFS ##
+
+// private textbox chunk -- a block of line text, lines never span chunks
+typedef struct _vtui_textbox_chunk {
+    char *text;
+    VTUI_SIZE used;
+    VTUI_SIZE lines; // lines still stored in this chunk
+} _vtui_textbox_chunk;
+
+// private textbox line
+typedef struct _vtui_textbox_line {
+    const char *text;  // not terminated
+    VTUI_SIZE bytes;
+    VTUI_SIZE cells;   // codepoints in the line
+    VTUI_SIZE chunk;   // chunk ring slot holding the text
+    VTUI_AXIS wrap_cols; // width the line was last wrapped at
+    VTUI_SIZE rows;    // visual rows at wrap_cols
+} _vtui_textbox_line;
+
+typedef struct vtui_textbox {
+    // fn pntrs
+#ifndef VTUI_STATIC_HOOKS
+    vtui_malloc *malloc;
+    vtui_free *free;
+    vtui_memcpy *memcpy;
+#endif
+
+    // variables
+
+    vtui_color fg;
+    vtui_color bg;
+
+    // private variables
+
+    // line ring, oldest line first; _first_seq numbers the oldest line
+    _vtui_textbox_line *_lines;
+    VTUI_SIZE _max_lines;
+    VTUI_SIZE _line_head;
+    VTUI_SIZE _line_count;
+    VTUI_SIZE _first_seq;
+
+    // chunk ring, the newest chunk is the one being appended to
+    _vtui_textbox_chunk *_chunks;
+    VTUI_SIZE _max_chunks;
+    VTUI_SIZE _chunk_head;
+    VTUI_SIZE _chunk_count;
+
+    // wrap index -- a fenwick tree of line heights, indexed by line ring slot
+    VTUI_SIZE *_wrap_tree;
+    VTUI_SIZE _wrap_step; // highest power of two <= _max_lines
+    VTUI_SIZE _total_rows;
+
+    // viewport, as of the last draw
+    VTUI_AXIS _rows;
+    VTUI_AXIS _cols;
+    VTUI_BOOL _follow; // stick to the newest line
+    VTUI_SIZE _top_seq;
+    VTUI_SIZE _top_subrow;
+
+    // glyph scratch, one terminated codepoint per drawn cell; the cells of the
+    // grid a textbox is drawn to point into it
+    char *_glyphs;
+    VTUI_SIZE _glyph_cells;
+
+    // where the textbox was last drawn, in its grid
+    vtui_grid *_grid;
+    VTUI_AXIS _grid_row;
+    VTUI_AXIS _grid_col;
+} vtui_textbox;
+
+// ## VTUI TEXTBOX WRAP INDEX ##
+
+// add to the height stored for a line ring slot (wraps around to subtract)
+void _vtui_textbox_indexAdd(vtui_textbox *tb, VTUI_SIZE slot, VTUI_SIZE delta) {
+    VTUI_SIZE i;
+    for (i = slot + 1; i <= tb->_max_lines; i += i & (~i + 1)) {
+        tb->_wrap_tree[i] += delta;
+    }
+    tb->_total_rows += delta;
+}
+
+// sum of the heights stored for line ring slots [0, slot)
+VTUI_SIZE _vtui_textbox_indexPrefix(vtui_textbox *tb, VTUI_SIZE slot) {
+    VTUI_SIZE sum = 0;
+    VTUI_SIZE i;
+    for (i = slot; i > 0; i -= i & (~i + 1)) {
+        sum += tb->_wrap_tree[i];
+    }
+    return sum;
+}
+
+// find the line ring slot holding the given visual row, counting from slot 0
+VTUI_SIZE _vtui_textbox_indexSearch(vtui_textbox *tb, VTUI_SIZE row) {
+    VTUI_SIZE pos = 0;
+    VTUI_SIZE step;
+    for (step = tb->_wrap_step; step > 0; step >>= 1) {
+        if (pos + step <= tb->_max_lines && tb->_wrap_tree[pos + step] <= row) {
+            pos += step;
+            row -= tb->_wrap_tree[pos];
+        }
+    }
+    return pos;
+}
+
+// ring slot of the line with the given index, 0 being the oldest line
+VTUI_SIZE _vtui_textbox_slot(vtui_textbox *tb, VTUI_SIZE line) {
+    return (tb->_line_head + line) % tb->_max_lines;
+}
+
+// visual rows above the line with the given index
+VTUI_SIZE _vtui_textbox_rowsBefore(vtui_textbox *tb, VTUI_SIZE line) {
+    VTUI_SIZE slot = _vtui_textbox_slot(tb, line);
+    VTUI_SIZE head = _vtui_textbox_indexPrefix(tb, tb->_line_head);
+    if (slot >= tb->_line_head) {
+        return _vtui_textbox_indexPrefix(tb, slot) - head;
+    } else {
+        // the ring has wrapped around, count the slots from the head onwards
+        return tb->_total_rows - head + _vtui_textbox_indexPrefix(tb, slot);
+    }
+}
+
+// index of the line holding the given visual row, the row must exist
+VTUI_SIZE _vtui_textbox_lineAt(vtui_textbox *tb, VTUI_SIZE row) {
+    VTUI_SIZE head = _vtui_textbox_indexPrefix(tb, tb->_line_head);
+    VTUI_SIZE slot;
+    if (row < tb->_total_rows - head) {
+        slot = _vtui_textbox_indexSearch(tb, row + head);
+    } else {
+        // the row lives in the part of the ring that has wrapped around
+        slot = _vtui_textbox_indexSearch(tb, row - (tb->_total_rows - head));
+    }
+    return (slot + tb->_max_lines - tb->_line_head) % tb->_max_lines;
+}
+
+// wrap a line to the given width, updating the index
+void _vtui_textbox_wrap(vtui_textbox *tb, VTUI_SIZE line, VTUI_AXIS cols) {
+    VTUI_SIZE slot = _vtui_textbox_slot(tb, line);
+    _vtui_textbox_line *ln = &tb->_lines[slot];
+    VTUI_SIZE rows = 1;
+    if (ln->wrap_cols == cols) {
+        return;
+    }
+    if (cols > 0 && ln->cells > cols) {
+        rows = (ln->cells + cols - 1) / cols;
+    }
+    _vtui_textbox_indexAdd(tb, slot, rows - ln->rows);
+    ln->rows = rows;
+    ln->wrap_cols = cols;
+}
+
+// ## VTUI TEXTBOX ROUTINES ##
+
+// initialize a textbox holding at most max_lines lines and max_chunks chunks
+// of text; the textbox's malloc, free, and memcpy must be set beforehand,
+// unless VTUI_STATIC_HOOKS is defined. can fail with VTUI_ENOMEM
+int vtui_textbox_init(vtui_textbox *tb, VTUI_SIZE max_lines,
+    VTUI_SIZE max_chunks) {
+    VTUI_SIZE i;
+    max_lines = vtui_max(max_lines, 1);
+    max_chunks = vtui_max(max_chunks, 1);
+    tb->_lines = (_vtui_textbox_line *) _vtui_malloc(tb)(
+        max_lines * sizeof(_vtui_textbox_line));
+    tb->_chunks = (_vtui_textbox_chunk *) _vtui_malloc(tb)(
+        max_chunks * sizeof(_vtui_textbox_chunk));
+    tb->_wrap_tree = (VTUI_SIZE *) _vtui_malloc(tb)(
+        (max_lines + 1) * sizeof(VTUI_SIZE));
+    if (tb->_lines == VTUI_NULL || tb->_chunks == VTUI_NULL
+        || tb->_wrap_tree == VTUI_NULL) {
+        // give up if any allocation failed
+        if (tb->_lines != VTUI_NULL) {
+            _vtui_free(tb)(tb->_lines);
+        }
+        if (tb->_chunks != VTUI_NULL) {
+            _vtui_free(tb)(tb->_chunks);
+        }
+        if (tb->_wrap_tree != VTUI_NULL) {
+            _vtui_free(tb)(tb->_wrap_tree);
+        }
+        tb->_lines = VTUI_NULL;
+        tb->_chunks = VTUI_NULL;
+        tb->_wrap_tree = VTUI_NULL;
+        return VTUI_ENOMEM;
+    }
+    // chunk text is allocated on first use
+    for (i = 0; i < max_chunks; i++) {
+        tb->_chunks[i].text = VTUI_NULL;
+        tb->_chunks[i].used = 0;
+        tb->_chunks[i].lines = 0;
+    }
+    for (i = 0; i <= max_lines; i++) {
+        tb->_wrap_tree[i] = 0;
+    }
+    tb->_max_lines = max_lines;
+    tb->_line_head = 0;
+    tb->_line_count = 0;
+    tb->_first_seq = 0;
+    tb->_max_chunks = max_chunks;
+    tb->_chunk_head = 0;
+    tb->_chunk_count = 0;
+    for (tb->_wrap_step = 1; tb->_wrap_step <= max_lines >> 1;) {
+        tb->_wrap_step <<= 1;
+    }
+    tb->_total_rows = 0;
+    tb->_rows = 0;
+    tb->_cols = 0;
+    tb->_follow = VTUI_TRUE;
+    tb->_top_seq = 0;
+    tb->_top_subrow = 0;
+    tb->_glyphs = VTUI_NULL;
+    tb->_glyph_cells = 0;
+    tb->_grid = VTUI_NULL;
+    tb->_grid_row = 0;
+    tb->_grid_col = 0;
+    return VTUI_OK;
+}
+
+// release the memory held by a textbox
+void vtui_textbox_release(vtui_textbox *tb) {
+    VTUI_SIZE i;
+    for (i = 0; i < tb->_max_chunks; i++) {
+        if (tb->_chunks[i].text != VTUI_NULL) {
+            _vtui_free(tb)(tb->_chunks[i].text);
+        }
+    }
+    if (tb->_glyphs != VTUI_NULL) {
+        _vtui_free(tb)(tb->_glyphs);
+    }
+    _vtui_free(tb)(tb->_lines);
+    _vtui_free(tb)(tb->_chunks);
+    _vtui_free(tb)(tb->_wrap_tree);
+    tb->_lines = VTUI_NULL;
+    tb->_chunks = VTUI_NULL;
+    tb->_wrap_tree = VTUI_NULL;
+    tb->_glyphs = VTUI_NULL;
+}
+
+// evict the oldest line
+void _vtui_textbox_evict(vtui_textbox *tb) {
+    _vtui_textbox_line *ln = &tb->_lines[tb->_line_head];
+    _vtui_textbox_chunk *chunk = &tb->_chunks[ln->chunk];
+    _vtui_textbox_indexAdd(tb, tb->_line_head, 0 - ln->rows);
+    chunk->lines--;
+    if (chunk->lines == 0 && tb->_chunk_count > 1
+        && ln->chunk == tb->_chunk_head) {
+        // the oldest chunk is empty, it can be reused
+        tb->_chunk_head = (tb->_chunk_head + 1) % tb->_max_chunks;
+        tb->_chunk_count--;
+    }
+    tb->_line_head = (tb->_line_head + 1) % tb->_max_lines;
+    tb->_line_count--;
+    tb->_first_seq++;
+}
+
+// find room for a line of text, evicting old lines if needed; can fail with
+// VTUI_ENOMEM
+int _vtui_textbox_reserve(vtui_textbox *tb, VTUI_SIZE bytes,
+    VTUI_SIZE *slot) {
+    _vtui_textbox_chunk *chunk;
+    if (tb->_chunk_count > 0) {
+        *slot = (tb->_chunk_head + tb->_chunk_count - 1) % tb->_max_chunks;
+        if (tb->_chunks[*slot].used + bytes <= VTUI_TEXTBOX_CHUNK_BYTES) {
+            // fits in the newest chunk
+            return VTUI_OK;
+        }
+        if (tb->_chunk_count == tb->_max_chunks) {
+            // out of chunks, evict every line in the oldest one
+            VTUI_SIZE oldest = tb->_chunk_head;
+            while (tb->_line_count > 0
+                && tb->_lines[tb->_line_head].chunk == oldest) {
+                _vtui_textbox_evict(tb);
+            }
+            if (tb->_chunk_head == oldest) {
+                // only one chunk, which is now empty
+                tb->_chunk_head = (tb->_chunk_head + 1) % tb->_max_chunks;
+                tb->_chunk_count--;
+            }
+        }
+    }
+    *slot = (tb->_chunk_head + tb->_chunk_count) % tb->_max_chunks;
+    chunk = &tb->_chunks[*slot];
+    if (chunk->text == VTUI_NULL) {
+        chunk->text = (char *) _vtui_malloc(tb)(VTUI_TEXTBOX_CHUNK_BYTES);
+        if (chunk->text == VTUI_NULL) {
+            return VTUI_ENOMEM;
+        }
+    }
+    chunk->used = 0;
+    chunk->lines = 0;
+    tb->_chunk_count++;
+    return VTUI_OK;
+}
+
+// append a line of utf8 text to a textbox, evicting the oldest lines if it is
+// full; the text should not contain newlines, and lines longer than
+// VTUI_TEXTBOX_CHUNK_BYTES are truncated. only the new line is wrapped, the
+// rest of the textbox is left untouched. can fail with VTUI_ENOMEM
+int vtui_textbox_append(vtui_textbox *tb, const char *text, VTUI_SIZE bytes) {
+    VTUI_SIZE chunk_slot;
+    VTUI_SIZE slot;
+    VTUI_SIZE i;
+    _vtui_textbox_chunk *chunk;
+    _vtui_textbox_line *ln;
+    if (bytes > VTUI_TEXTBOX_CHUNK_BYTES) {
+        // truncate, without splitting a codepoint
+        bytes = VTUI_TEXTBOX_CHUNK_BYTES;
+        while (bytes > 0 && (((VTUI_BYTE) text[bytes]) & 0xC0) == 0x80) {
+            bytes--;
+        }
+    }
+    if (tb->_line_count == tb->_max_lines) {
+        _vtui_textbox_evict(tb);
+    }
+    int err = _vtui_textbox_reserve(tb, bytes, &chunk_slot);
+    if (err != VTUI_OK) {
+        return err;
+    }
+    chunk = &tb->_chunks[chunk_slot];
+    if (bytes > 0) {
+        _vtui_memcpy(tb)(&chunk->text[chunk->used], text, bytes);
+    }
+    slot = _vtui_textbox_slot(tb, tb->_line_count);
+    ln = &tb->_lines[slot];
+    ln->text = &chunk->text[chunk->used];
+    ln->bytes = bytes;
+    ln->chunk = chunk_slot;
+    ln->cells = 0;
+    for (i = 0; i < bytes; i++) {
+        // count everything but continuation bytes
+        if ((((VTUI_BYTE) text[i]) & 0xC0) != 0x80) {
+            ln->cells++;
+        }
+    }
+    ln->rows = 0;
+    ln->wrap_cols = (VTUI_AXIS) -1; // never wrapped
+    chunk->used += bytes;
+    chunk->lines++;
+    tb->_line_count++;
+    _vtui_textbox_wrap(tb, tb->_line_count - 1, tb->_cols);
+    return VTUI_OK;
+}
+
+// number of lines currently stored in a textbox
+VTUI_SIZE vtui_textbox_lines(vtui_textbox *tb) {
+    return tb->_line_count;
+}
+
+// scroll a textbox by the given number of visual rows, negative values scroll
+// towards older lines; scrolling to the bottom resumes following new lines
+void vtui_textbox_scroll(vtui_textbox *tb, VTUI_LI_AXIS rows) {
+    VTUI_SIZE top;
+    VTUI_SIZE line;
+    if (tb->_line_count == 0 || rows == 0) {
+        return;
+    }
+    if (tb->_top_seq < tb->_first_seq) {
+        // the top line has been evicted
+        tb->_top_seq = tb->_first_seq;
+        tb->_top_subrow = 0;
+    }
+    line = tb->_top_seq - tb->_first_seq;
+    if (line >= tb->_line_count) {
+        line = tb->_line_count - 1;
+        tb->_top_subrow = 0;
+    }
+    top = _vtui_textbox_rowsBefore(tb, line) + tb->_top_subrow;
+    if (rows < 0) {
+        top -= vtui_min((VTUI_SIZE) -rows, top);
+        tb->_follow = VTUI_FALSE;
+    } else {
+        top += (VTUI_SIZE) rows;
+    }
+    if (top + tb->_rows >= tb->_total_rows) {
+        // reached the bottom
+        tb->_follow = VTUI_TRUE;
+        return;
+    }
+    line = _vtui_textbox_lineAt(tb, top);
+    tb->_top_seq = tb->_first_seq + line;
+    tb->_top_subrow = top - _vtui_textbox_rowsBefore(tb, line);
+}
+
+// make sure a textbox has scratch for the given number of cells, can fail with
+// VTUI_ENOMEM
+int _vtui_textbox_reserveGlyphs(vtui_textbox *tb, VTUI_SIZE cells) {
+    VTUI_SIZE i;
+    if (cells <= tb->_glyph_cells) {
+        return VTUI_OK;
+    }
+    char *pntr = (char *) _vtui_malloc(tb)(
+        cells * _VTUI_TEXTBOX_GLYPH_BYTES);
+    if (pntr == VTUI_NULL) {
+        return VTUI_ENOMEM;
+    }
+    if (tb->_glyphs != VTUI_NULL) {
+        _vtui_free(tb)(tb->_glyphs);
+    }
+    for (i = 0; i < cells * _VTUI_TEXTBOX_GLYPH_BYTES; i++) {
+        pntr[i] = VTUI_NUL[0];
+    }
+    tb->_glyphs = pntr;
+    tb->_glyph_cells = cells;
+    return VTUI_OK;
+}
+
+// draw a single visual row of a line (or a blank row, if line is NULL) into a
+// row of a grid, touching the row only if something actually changed
+void _vtui_textbox_drawRow(vtui_textbox *tb, vtui_grid *grid,
+    VTUI_AXIS grid_row, VTUI_AXIS grid_col, VTUI_AXIS cols, char *glyphs,
+    _vtui_textbox_line *ln, VTUI_SIZE subrow) {
+    vtui_cell *cells = &grid->cells[(VTUI_SIZE) grid_row * grid->cols];
+    VTUI_SIZE pos = 0;
+    VTUI_SIZE skip = (VTUI_SIZE) subrow * cols;
+    VTUI_BOOL changed = VTUI_FALSE;
+    VTUI_AXIS col;
+    if (ln != VTUI_NULL) {
+        // skip to the start of the visual row
+        while (pos < ln->bytes && skip > 0) {
+            pos++;
+            while (pos < ln->bytes
+                && (((VTUI_BYTE) ln->text[pos]) & 0xC0) == 0x80) {
+                pos++;
+            }
+            skip--;
+        }
+    }
+    for (col = 0; col < cols; col++) {
+        char *glyph = &glyphs[(VTUI_SIZE) col * _VTUI_TEXTBOX_GLYPH_BYTES];
+        vtui_cell *cell = &cells[grid_col + col];
+        int len = 0;
+        if (ln != VTUI_NULL && pos < ln->bytes) {
+            // copy a single codepoint, which is never more than four bytes
+            do {
+                if (len < 4 && glyph[len] != ln->text[pos]) {
+                    glyph[len] = ln->text[pos];
+                    changed = VTUI_TRUE;
+                }
+                len++;
+                pos++;
+            } while (pos < ln->bytes
+                && (((VTUI_BYTE) ln->text[pos]) & 0xC0) == 0x80);
+            len = vtui_min(len, 4);
+        }
+        if (glyph[len] != VTUI_NUL[0]) {
+            glyph[len] = VTUI_NUL[0];
+            changed = VTUI_TRUE;
+        }
+        if (cell->grapheme != glyph || !_vtui_colorEq(cell->fg, tb->fg)
+            || !_vtui_colorEq(cell->bg, tb->bg)) {
+            cell->grapheme = glyph;
+            cell->fg = tb->fg;
+            cell->bg = tb->bg;
+            changed = VTUI_TRUE;
+        }
+    }
+    if (changed) {
+        vtui_grid_touch(grid, grid_row);
+    }
+}
+
+// blank the cells of the region a textbox was last drawn to that still point
+// into its glyph scratch, before the scratch is laid out anew
+void _vtui_textbox_unlink(vtui_textbox *tb) {
+    vtui_grid *grid = tb->_grid;
+    VTUI_AXIS r;
+    VTUI_AXIS c;
+    if (grid == VTUI_NULL) {
+        return;
+    }
+    for (r = 0; r < tb->_rows && tb->_grid_row + r < grid->rows; r++) {
+        VTUI_AXIS grid_row = tb->_grid_row + r;
+        vtui_cell *cells = &grid->cells[(VTUI_SIZE) grid_row * grid->cols];
+        VTUI_BOOL changed = VTUI_FALSE;
+        for (c = 0; c < tb->_cols && tb->_grid_col + c < grid->cols; c++) {
+            vtui_cell *cell = &cells[tb->_grid_col + c];
+            VTUI_SIZE glyph = (VTUI_SIZE) r * tb->_cols + c;
+            if (cell->grapheme
+                == &tb->_glyphs[glyph * _VTUI_TEXTBOX_GLYPH_BYTES]) {
+                cell->grapheme = VTUI_NULL;
+                changed = VTUI_TRUE;
+            }
+        }
+        if (changed) {
+            vtui_grid_touch(grid, grid_row);
+        }
+    }
+    tb->_grid = VTUI_NULL;
+}
+
+// draw a textbox into a region of a grid, clipped to the grid. lines are
+// wrapped to the width of the region as they are drawn; the cells drawn point
+// into the textbox, and stay valid until it is released. when the region (or
+// grid) changes, the cells drawn last time are blanked first, so the grid last
+// drawn to must still be alive. can fail with VTUI_ENOMEM
+int vtui_textbox_draw(vtui_textbox *tb, vtui_grid *grid, VTUI_AXIS row,
+    VTUI_AXIS col, VTUI_AXIS rows, VTUI_AXIS cols) {
+    VTUI_SIZE line;
+    VTUI_SIZE subrow;
+    VTUI_AXIS r;
+    rows = row < grid->rows ? vtui_min(rows, grid->rows - row) : 0;
+    cols = col < grid->cols ? vtui_min(cols, grid->cols - col) : 0;
+    if (grid != tb->_grid || row != tb->_grid_row || col != tb->_grid_col
+        || rows != tb->_rows || cols != tb->_cols) {
+        // the glyph scratch is laid out by region, so cells drawn at the old
+        // geometry would be left pointing at other cells' glyphs
+        _vtui_textbox_unlink(tb);
+    }
+    int err = _vtui_textbox_reserveGlyphs(tb, (VTUI_SIZE) rows * cols);
+    if (err != VTUI_OK) {
+        return err;
+    }
+    // on a new width, lines are rewrapped lazily as they are drawn
+    tb->_cols = cols;
+    tb->_rows = rows;
+    tb->_grid = grid;
+    tb->_grid_row = row;
+    tb->_grid_col = col;
+    if (tb->_follow && tb->_line_count > 0) {
+        // walk up from the newest line until the region is full
+        VTUI_SIZE filled = 0;
+        line = tb->_line_count;
+        while (line > 0 && filled < rows) {
+            line--;
+            _vtui_textbox_wrap(tb, line, cols);
+            filled += tb->_lines[_vtui_textbox_slot(tb, line)].rows;
+        }
+        tb->_top_seq = tb->_first_seq + line;
+        tb->_top_subrow = filled > rows ? filled - rows : 0;
+    } else if (tb->_top_seq < tb->_first_seq) {
+        // the top line has been evicted
+        tb->_top_seq = tb->_first_seq;
+        tb->_top_subrow = 0;
+    }
+    line = tb->_top_seq - tb->_first_seq;
+    subrow = tb->_top_subrow;
+    for (r = 0; r < rows; r++) {
+        _vtui_textbox_line *ln = VTUI_NULL;
+        while (line < tb->_line_count) {
+            _vtui_textbox_wrap(tb, line, cols);
+            ln = &tb->_lines[_vtui_textbox_slot(tb, line)];
+            if (subrow < ln->rows) {
+                break;
+            }
+            // the line was rewrapped shorter, or is done
+            ln = VTUI_NULL;
+            line++;
+            subrow = 0;
+        }
+        _vtui_textbox_drawRow(tb, grid, row + r, col, cols,
+            &tb->_glyphs[(VTUI_SIZE) r * cols * _VTUI_TEXTBOX_GLYPH_BYTES],
+            ln, subrow);
+        subrow++;
+    }
+    return VTUI_OK;
+}
+
+#endif
@@ -0,0 +1,325 @@
+// vtui shared -- drawing into a grid from many threads at once
+
+/*
+The Clear BSD License
+
+Copyright (c) 2021 Valyrie Autumn
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted (subject to the limitations in the disclaimer
+below) provided that the following conditions are met:
+
+     * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+
+     * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+
+     * Neither the name of the copyright holder nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef vtui_threads_h
+#define vtui_threads_h
+
+// a vtui_shared sits between a vtui_grid and any number of producer threads,
+// each of which owns a vtui_region -- a rectangle of the grid, disjoint from
+// every other region. a producer draws into its region's private cells, which
+// no other thread touches, and publishes them with vtui_region_commit. the
+// thread rendering the grid calls vtui_shared_snapshot before vtui_update to
+// bring every commit into the grid.
+
+// a commit copies the rows drawn since the last one into the region's staging,
+// behind a spinlock only ever shared with the snapshot, so producers never
+// contend with each other. a region with something staged is pushed onto a
+// lock-free list in the vtui_shared, which the snapshot takes whole with an
+// atomic exchange; it never walks idle regions, and never waits on anything
+// but a single region's copy.
+
+// a region's commits land in the grid as a unit -- every row of a commit lands
+// in the same snapshot, and only the region's own cells are ever written.
+// graphemes are copied by pointer, and must stay valid for as long as they
+// are on the grid, same as any other grid.
+
+// needs C11 atomics, or C++11 atomics when compiled as C++ -- <stdatomic.h>
+// is only usable from C++23, so the same names are brought in from <atomic>
+// instead. the grid must not be resized while any region is drawing into it.
+
+#ifdef __cplusplus
+
+#include <atomic>
+
+#define _VTUI_ATOMIC(type) std::atomic<type>
+
+using std::atomic_bool;
+using std::atomic_flag;
+using std::atomic_compare_exchange_weak_explicit;
+using std::atomic_exchange_explicit;
+using std::atomic_flag_clear;
+using std::atomic_flag_clear_explicit;
+using std::atomic_flag_test_and_set_explicit;
+using std::atomic_init;
+using std::atomic_load_explicit;
+using std::atomic_store_explicit;
+using std::memory_order_acq_rel;
+using std::memory_order_acquire;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+
+#else
+
+#include <stdatomic.h>
+
+#define _VTUI_ATOMIC(type) _Atomic(type)
+
+#endif
+
+#include "vtui.h"
+
+// ## VTUI SHARED TYPEDEFS ##
+
+typedef struct vtui_region vtui_region;
+
+typedef struct vtui_shared {
+    // fn pntrs, used by every region of the vtui_shared
+#ifndef VTUI_STATIC_HOOKS
+    vtui_malloc *malloc;
+    vtui_free *free;
+    vtui_memcpy *memcpy;
+#endif
+
+    // private variables
+
+    vtui_grid *_grid;
+    _VTUI_ATOMIC(vtui_region *) _pending; // regions with commits staged
+} vtui_shared;
+
+struct vtui_region {
+    // private variables
+
+    vtui_shared *_shared;
+    VTUI_AXIS _row;
+    VTUI_AXIS _col;
+    VTUI_AXIS _rows;
+    VTUI_AXIS _cols;
+
+    // drawn by the producer, rows drawn since the last commit are dirty
+    vtui_cell *_cells;
+    VTUI_BOOL *_dirty;
+
+    // committed by the producer, and not yet brought into the grid; guarded
+    // by _lock
+    atomic_flag _lock;
+    vtui_cell *_staged;
+    VTUI_BOOL *_staged_dirty;
+
+    // set while the region is on its vtui_shared's pending list
+    atomic_bool _pending;
+    vtui_region *_next;
+};
+
+// ## VTUI SHARED ROUTINES ##
+
+// spin on a region's lock; it is only ever held for the copy of its rows, and
+// only ever contended by the snapshot
+void _vtui_region_lock(vtui_region *region) {
+    while (atomic_flag_test_and_set_explicit(&region->_lock,
+        memory_order_acquire)) {
+        // spin
+    }
+}
+
+void _vtui_region_unlock(vtui_region *region) {
+    atomic_flag_clear_explicit(&region->_lock, memory_order_release);
+}
+
+// attach a vtui_shared to a grid; its hooks must be set beforehand, unless
+// VTUI_STATIC_HOOKS is defined
+void vtui_shared_init(vtui_shared *shared, vtui_grid *grid) {
+    shared->_grid = grid;
+    atomic_init(&shared->_pending, (vtui_region *) VTUI_NULL);
+}
+
+// bring every region committed since the last snapshot into the grid, marking
+// each row written as such; call from the thread that owns the grid, before
+// updating any vtui drawing it. returns the number of regions brought in
+VTUI_SIZE vtui_shared_snapshot(vtui_shared *shared) {
+    vtui_grid *grid = shared->_grid;
+    vtui_region *region = atomic_exchange_explicit(&shared->_pending,
+        (vtui_region *) VTUI_NULL, memory_order_acquire);
+    VTUI_SIZE regions = 0;
+    while (region != VTUI_NULL) {
+        // once no longer pending, the region may be pushed again at any time
+        vtui_region *next = region->_next;
+        VTUI_AXIS row;
+        _vtui_region_lock(region);
+        // pairs with the acq_rel exchange in vtui_region_commit
+        atomic_store_explicit(&region->_pending, VTUI_FALSE,
+            memory_order_release);
+        for (row = 0; row < region->_rows; row++) {
+            VTUI_AXIS grid_row = region->_row + row;
+            if (!region->_staged_dirty[row] || grid_row >= grid->rows
+                || region->_col >= grid->cols) {
+                continue;
+            }
+            region->_staged_dirty[row] = VTUI_FALSE;
+            _vtui_memcpy(shared)(
+                &vtui_grid_editRow(grid, grid_row)[region->_col],
+                &region->_staged[(VTUI_SIZE) row * region->_cols],
+                vtui_min(region->_cols, grid->cols - region->_col)
+                    * sizeof(vtui_cell));
+        }
+        _vtui_region_unlock(region);
+        regions++;
+        region = next;
+    }
+    return regions;
+}
+
+// ## VTUI REGION ROUTINES ##
+
+// claim a rectangle of a vtui_shared's grid for a producer, clipped to the
+// grid; regions must not overlap. the region starts out with the grid's
+// current contents, so call from the thread that owns the grid. can fail with
+// VTUI_ENOMEM
+int vtui_region_init(vtui_region *region, vtui_shared *shared,
+    VTUI_AXIS row, VTUI_AXIS col, VTUI_AXIS rows, VTUI_AXIS cols) {
+    vtui_grid *grid = shared->_grid;
+    VTUI_SIZE cells;
+    VTUI_AXIS r;
+    row = vtui_min(row, grid->rows);
+    col = vtui_min(col, grid->cols);
+    rows = vtui_min(rows, grid->rows - row);
+    cols = vtui_min(cols, grid->cols - col);
+    cells = vtui_max((VTUI_SIZE) rows * cols, 1);
+    region->_cells = (vtui_cell *) _vtui_malloc(shared)(
+        cells * sizeof(vtui_cell));
+    region->_staged = (vtui_cell *) _vtui_malloc(shared)(
+        cells * sizeof(vtui_cell));
+    region->_dirty = (VTUI_BOOL *) _vtui_malloc(shared)(
+        vtui_max(rows, 1) * sizeof(VTUI_BOOL));
+    region->_staged_dirty = (VTUI_BOOL *) _vtui_malloc(shared)(
+        vtui_max(rows, 1) * sizeof(VTUI_BOOL));
+    if (region->_cells == VTUI_NULL || region->_staged == VTUI_NULL
+        || region->_dirty == VTUI_NULL || region->_staged_dirty == VTUI_NULL) {
+        // give up if any allocation failed
+        if (region->_cells != VTUI_NULL) {
+            _vtui_free(shared)(region->_cells);
+        }
+        if (region->_staged != VTUI_NULL) {
+            _vtui_free(shared)(region->_staged);
+        }
+        if (region->_dirty != VTUI_NULL) {
+            _vtui_free(shared)(region->_dirty);
+        }
+        if (region->_staged_dirty != VTUI_NULL) {
+            _vtui_free(shared)(region->_staged_dirty);
+        }
+        region->_cells = VTUI_NULL;
+        region->_staged = VTUI_NULL;
+        region->_dirty = VTUI_NULL;
+        region->_staged_dirty = VTUI_NULL;
+        return VTUI_ENOMEM;
+    }
+    for (r = 0; r < rows; r++) {
+        const vtui_cell *src = &grid->cells[(VTUI_SIZE) (row + r) * grid->cols
+            + col];
+        VTUI_SIZE offset = (VTUI_SIZE) r * cols;
+        _vtui_memcpy(shared)(&region->_cells[offset], src,
+            cols * sizeof(vtui_cell));
+        _vtui_memcpy(shared)(&region->_staged[offset], src,
+            cols * sizeof(vtui_cell));
+        region->_dirty[r] = VTUI_FALSE;
+        region->_staged_dirty[r] = VTUI_FALSE;
+    }
+    region->_shared = shared;
+    region->_row = row;
+    region->_col = col;
+    region->_rows = rows;
+    region->_cols = cols;
+    atomic_flag_clear(&region->_lock);
+    atomic_init(&region->_pending, VTUI_FALSE);
+    region->_next = VTUI_NULL;
+    return VTUI_OK;
+}
+
+// free a region's memory, once its producer is done with it; call from the
+// thread that owns the grid. anything committed is brought into the grid
+// first, anything drawn since the last commit is dropped
+void vtui_region_release(vtui_region *region) {
+    vtui_shared *shared = region->_shared;
+    vtui_shared_snapshot(shared);
+    _vtui_free(shared)(region->_cells);
+    _vtui_free(shared)(region->_staged);
+    _vtui_free(shared)(region->_dirty);
+    _vtui_free(shared)(region->_staged_dirty);
+    region->_cells = VTUI_NULL;
+    region->_staged = VTUI_NULL;
+    region->_dirty = VTUI_NULL;
+    region->_staged_dirty = VTUI_NULL;
+}
+
+// get a writable pointer to a row of a region, marking the row as drawn; rows
+// are relative to the region
+vtui_cell *vtui_region_editRow(vtui_region *region, VTUI_AXIS row) {
+    region->_dirty[row] = VTUI_TRUE;
+    return &region->_cells[(VTUI_SIZE) row * region->_cols];
+}
+
+// write a single cell of a region, relative to the region; writes outside of
+// the region are clipped
+void vtui_region_put(vtui_region *region, VTUI_AXIS row, VTUI_AXIS col,
+    vtui_cell cell) {
+    if (row < region->_rows && col < region->_cols) {
+        vtui_region_editRow(region, row)[col] = cell;
+    }
+}
+
+// publish every row of a region drawn since the last commit; all of them are
+// brought into the grid together, by the next vtui_shared_snapshot
+void vtui_region_commit(vtui_region *region) {
+    vtui_shared *shared = region->_shared;
+    VTUI_BOOL staged = VTUI_FALSE;
+    VTUI_AXIS row;
+    _vtui_region_lock(region);
+    for (row = 0; row < region->_rows; row++) {
+        VTUI_SIZE offset = (VTUI_SIZE) row * region->_cols;
+        if (!region->_dirty[row]) {
+            continue;
+        }
+        region->_dirty[row] = VTUI_FALSE;
+        region->_staged_dirty[row] = VTUI_TRUE;
+        _vtui_memcpy(shared)(&region->_staged[offset],
+            &region->_cells[offset], region->_cols * sizeof(vtui_cell));
+        staged = VTUI_TRUE;
+    }
+    _vtui_region_unlock(region);
+    if (staged && !atomic_exchange_explicit(&region->_pending, VTUI_TRUE,
+        memory_order_acq_rel)) {
+        // push the region onto the pending list
+        vtui_region *head = atomic_load_explicit(&shared->_pending,
+            memory_order_relaxed);
+        do {
+            region->_next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&shared->_pending,
+            &head, region, memory_order_release, memory_order_relaxed));
+    }
+}
+
+#endif